@@ -29,14 +29,27 @@ using err_code = boost::system::error_code;
 
 namespace tpcc {
 
+void Client::close() {
+    boost::system::error_code ec;
+    mStream->close(ec);
+}
+
+bool Client::timeIsUp(decltype(Clock::now()) now) {
+    if (now <= mEndTime) {
+        return false;
+    }
+    // Time's up
+    // benchmarking finished as soon as all streams are done
+    if (--mActive == 0) {
+        close();
+    }
+    return true;
+}
+
 template <Command C>
 void Client::execute(const typename Signature<C>::arguments &arg) {
     auto now = Clock::now();
-    if (now > mEndTime) {
-        // Time's up
-        // benchmarking finished
-        mSocket.shutdown(Socket::shutdown_both);
-        mSocket.close();
+    if (timeIsUp(now)) {
         return;
     }
     mCmds.execute<C>(
@@ -49,31 +62,97 @@ void Client::execute(const typename Signature<C>::arguments &arg) {
           if (!result.success) {
               LOG_ERROR("Transaction unsuccessful [error = %1%]", result.error);
           }
-          mLog.push_back(LogEntry{result.success, result.error, C, now, end});
-          run();
+          mLog.push_back(LogEntry{result.success, result.error, C, now, end, result.abortReason, result.attempts});
+          next();
       },
       arg);
 }
 
-void Client::run() {
+void Client::executeBatch() {
+    auto now = Clock::now();
+    if (timeIsUp(now)) {
+        return;
+    }
+    std::vector<TransactionIn> batch;
+    batch.reserve(mBatchSize);
+    for (unsigned i = 0; i < mBatchSize; ++i) {
+        batch.emplace_back(generate());
+    }
+    mCmds.execute<Command::BATCH>(
+      [this, now](const err_code &ec, const std::vector<TransactionResult>& results) {
+          if (ec) {
+              LOG_ERROR("Error: " + ec.message());
+              return;
+          }
+          auto end = Clock::now();
+          for (const auto& result : results) {
+              if (!result.success()) {
+                  LOG_ERROR("Transaction unsuccessful [error = %1%]", result.error());
+              }
+              mLog.push_back(LogEntry{result.success(), result.error(), result.command, now, end,
+                          result.abortReason(), result.attempts()});
+          }
+          next();
+      },
+      batch);
+}
+
+void Client::run(unsigned inFlight, unsigned batchSize) {
+    mActive = inFlight;
+    mBatchSize = batchSize;
+    for (unsigned i = 0; i < inFlight; ++i) {
+        next();
+    }
+}
+
+void Client::next() {
+    if (mBatchSize > 1) {
+        executeBatch();
+        return;
+    }
+    auto in = generate();
+    switch (in.command) {
+    case Command::STOCK_LEVEL:
+        execute<Command::STOCK_LEVEL>(in.stockLevel);
+        break;
+    case Command::DELIVERY:
+        execute<Command::DELIVERY>(in.delivery);
+        break;
+    case Command::ORDER_STATUS:
+        execute<Command::ORDER_STATUS>(in.orderStatus);
+        break;
+    case Command::PAYMENT:
+        execute<Command::PAYMENT>(in.payment);
+        break;
+    case Command::NEW_ORDER:
+        execute<Command::NEW_ORDER>(in.newOrder);
+        break;
+    default:
+        assert(false);
+    }
+}
+
+TransactionIn Client::generate() {
+    TransactionIn in;
     auto n = rnd.random<int>(1, 100);
     if (n <= 4) {
         LOG_DEBUG("Start stock-level Transaction");
-        StockLevelIn args;
+        in.command = Command::STOCK_LEVEL;
+        auto& args = in.stockLevel;
         args.w_id      = mCurrWarehouse;
         args.d_id      = mCurrDistrict;
         args.threshold = rnd.randomWithin<int32_t>(10, 20);
-        execute<Command::STOCK_LEVEL>(args);
         mCurrDistrict = mCurrDistrict == 10 ? 1 : (mCurrDistrict + 1);
     } else if (n <= 8) {
         LOG_DEBUG("Start delivery Transaction");
-        DeliveryIn arg;
+        in.command = Command::DELIVERY;
+        auto& arg = in.delivery;
         arg.w_id         = mCurrWarehouse;
         arg.o_carrier_id = rnd.random<int16_t>(1, 10);
-        execute<Command::DELIVERY>(arg);
     } else if (n <= 12) {
         LOG_DEBUG("Start order-status Transaction");
-        OrderStatusIn arg;
+        in.command = Command::ORDER_STATUS;
+        auto& arg = in.orderStatus;
         arg.w_id             = mCurrWarehouse;
         arg.d_id             = rnd.random<int16_t>(1, 10);
         arg.selectByLastName = 6 <= rnd.random<int>(1, 10);
@@ -82,10 +161,10 @@ void Client::run() {
         } else {
             arg.c_id = rnd.NURand<int32_t>(1023, 1, 3000);
         }
-        execute<Command::ORDER_STATUS>(arg);
     } else if (n <= 55) {
         LOG_DEBUG("Start payment Transaction");
-        PaymentIn arg;
+        in.command = Command::PAYMENT;
+        auto& arg = in.payment;
         arg.w_id = mCurrWarehouse;
         arg.d_id = rnd.random<int16_t>(1, 10);
         auto x   = rnd.random(1, 100);
@@ -104,17 +183,33 @@ void Client::run() {
             arg.c_id = rnd.NURand<int32_t>(1023, 1, 3000);
         }
         arg.h_amount = rnd.random<int32_t>(100, 500000);
-        execute<Command::PAYMENT>(arg);
     } else {
         LOG_DEBUG("Start new-order Transaction");
-        NewOrderIn arg;
+        in.command = Command::NEW_ORDER;
+        auto& arg = in.newOrder;
         arg.w_id = mCurrWarehouse;
         arg.d_id = rnd.random<int16_t>(1, 10);
         arg.c_id = rnd.NURand<int32_t>(1023, 1, 3000);
-        execute<Command::NEW_ORDER>(arg);
+        arg.o_ol_cnt = rnd.random<int16_t>(5, 15);
+        bool rollback = rnd.random<int>(1, 100) == 1;
+        for (int16_t i = 0; i < arg.o_ol_cnt; ++i) {
+            auto& line = arg.lines[i];
+            line.ol_i_id = rnd.NURand<int32_t>(8191, 1, NUM_ITEMS);
+            if (rollback && i == arg.o_ol_cnt - 1) {
+                line.ol_i_id = NUM_ITEMS + 1;
+            }
+            line.ol_supply_w_id = mCurrWarehouse;
+            if (mNumWarehouses > 1 && rnd.random<int>(1, 100) == 1) {
+                while (line.ol_supply_w_id == mCurrWarehouse) {
+                    line.ol_supply_w_id = rnd.random<int16_t>(1, mNumWarehouses);
+                }
+            }
+            line.ol_quantity = rnd.random<int16_t>(1, 10);
+        }
     }
     mCurrWarehouse = mCurrWarehouse == mWareHouseUpper ? mWareHouseLower
                                                        : (mCurrWarehouse + 1);
+    return in;
 }
 
 void Client::populate(bool useCH) { populate(mWareHouseLower, mWareHouseUpper, useCH); }
@@ -130,8 +225,7 @@ void Client::populate(int16_t lower, int16_t upper, bool useCH) {
           LOG_ASSERT(std::get<0>(res), std::get<1>(res));
           LOG_INFO(("Populated Warehouse " + crossbow::to_string(lower)));
           if (lower == upper) {
-              mSocket.shutdown(Socket::shutdown_both);
-              mSocket.close();
+              close();
               return; // population done
           }
           populate(lower + 1, upper, useCH);
@@ -39,11 +39,12 @@ struct LogEntry {
     Command transaction;
     decltype(Clock::now()) start;
     decltype(start) end;
+    AbortReason abortReason;
+    uint16_t attempts;
 };
 
 class Client {
-    using Socket = boost::asio::ip::tcp::socket;
-    Socket mSocket;
+    std::unique_ptr<Stream> mStream;
     client::CommandsImpl mCmds;
     int16_t mNumWarehouses;
     int16_t mWareHouseLower;
@@ -53,10 +54,12 @@ class Client {
     Random_t rnd;
     std::deque<LogEntry> mLog;
     decltype(Clock::now()) mEndTime;
+    unsigned mActive = 0;
+    unsigned mBatchSize = 1;
 public:
-    Client(boost::asio::io_service& service, int16_t numWarehouses, int16_t wareHouseLower, int16_t wareHouseUpper, decltype(Clock::now()) endTime)
-        : mSocket(service)
-        , mCmds(mSocket)
+    Client(std::unique_ptr<Stream> stream, int16_t numWarehouses, int16_t wareHouseLower, int16_t wareHouseUpper, decltype(Clock::now()) endTime)
+        : mStream(std::move(stream))
+        , mCmds(*mStream)
         , mNumWarehouses(numWarehouses)
         , mWareHouseLower(wareHouseLower)
         , mWareHouseUpper(wareHouseUpper)
@@ -64,19 +67,26 @@ public:
         , mCurrDistrict(1)
         , mEndTime(endTime)
     {}
-    Socket& socket() {
-        return mSocket;
-    }
-    const Socket& socket() const {
-        return mSocket;
+    Stream& stream() {
+        return *mStream;
     }
     client::CommandsImpl& commands() {
         return mCmds;
     }
-    void run();
+    /**
+     * Runs inFlight transaction streams over this connection until the end
+     * time is reached. With a batchSize larger than one every request carries
+     * batchSize transactions.
+     */
+    void run(unsigned inFlight = 1, unsigned batchSize = 1);
     void populate(bool useCH);
     const std::deque<LogEntry>& log() const { return mLog; }
 private:
+    bool timeIsUp(decltype(Clock::now()) now);
+    void close();
+    void next();
+    TransactionIn generate();
+    void executeBatch();
     void populate(int16_t lower, int16_t upper, bool useCH);
     template<Command C>
     void execute(const typename Signature<C>::arguments& arg);
@@ -38,6 +38,81 @@ using namespace crossbow::program_options;
 using namespace boost::asio;
 using err_code = boost::system::error_code;
 
+namespace {
+
+const char* commandName(tpcc::Command command) {
+    switch (command) {
+    case tpcc::Command::POPULATE_WAREHOUSE:
+        return "Populate";
+    case tpcc::Command::POPULATE_DIM_TABLES:
+        return "Populate";
+    case tpcc::Command::CREATE_SCHEMA:
+        return "Schema Create";
+    case tpcc::Command::STOCK_LEVEL:
+        return "Stock Level";
+    case tpcc::Command::DELIVERY:
+        return "Delivery";
+    case tpcc::Command::NEW_ORDER:
+        return "New Order";
+    case tpcc::Command::ORDER_STATUS:
+        return "Order Status";
+    case tpcc::Command::PAYMENT:
+        return "Payment";
+    case tpcc::Command::EXIT:
+        return "Exit";
+    case tpcc::Command::BATCH:
+        return "Batch";
+    case tpcc::Command::SET_RESULT_MODE:
+        return "Set Result Mode";
+    case tpcc::Command::STATS:
+        return "Stats";
+    }
+    assert(false);
+    return "";
+}
+
+// upper bound in microseconds of the bucket the given quantile falls into
+uint64_t latencyQuantile(const tpcc::CommandStats& stats, double q) {
+    uint64_t total = 0;
+    for (auto n : stats.latencyHistogram) {
+        total += n;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < stats.latencyHistogram.size(); ++i) {
+        seen += stats.latencyHistogram[i];
+        if (seen >= q * total) {
+            return uint64_t(2) << i;
+        }
+    }
+    return 0;
+}
+
+void printStats(std::ostream& out, const std::string& host, const tpcc::StatsResult& stats) {
+    out << host << ": " << stats.running << " running, " << stats.queued << " queued\n";
+    for (const auto& cmd : stats.commands) {
+        out << "  " << commandName(cmd.command) << ": " << cmd.commits << " commits, " << cmd.aborts << " aborts, "
+            << cmd.retries << " retries"
+            << ", critical path " << (cmd.commits == 0 ? 0.0 : double(cmd.criticalPath) / cmd.commits)
+            << " round trips"
+            << ", latency p50 < " << latencyQuantile(cmd, 0.5) << "us"
+            << ", p90 < " << latencyQuantile(cmd, 0.9) << "us"
+            << ", p99 < " << latencyQuantile(cmd, 0.99) << "us\n";
+        for (const auto& reason : cmd.abortReasons) {
+            out << "    " << reason.second << "x " << tpcc::abortReasonName(reason.first) << '\n';
+        }
+        out << "    histogram:";
+        for (size_t i = 0; i < cmd.latencyHistogram.size(); ++i) {
+            if (cmd.latencyHistogram[i] != 0) {
+                out << " <" << (uint64_t(2) << i) << "us:" << cmd.latencyHistogram[i];
+            }
+        }
+        out << '\n';
+    }
+    out.flush();
+}
+
+} // anonymous namespace
+
 int main(int argc, const char** argv) {
     bool help = false;
     bool populate = false;
@@ -45,21 +120,31 @@ int main(int argc, const char** argv) {
     int16_t numWarehouses = 1;
     crossbow::string host;
     std::string port("8713");
+    std::string transport("tcp");
     std::string logLevel("DEBUG");
     std::string outFile("out.csv");
     size_t numClients = 1;
+    unsigned inFlight = 1;
+    unsigned batchSize = 1;
+    bool statusOnly = false;
     unsigned time = 5*60;
     bool exit = false;
+    bool stats = false;
     auto opts = create_options("tpcc_client",
             value<'h'>("help", &help, tag::description{"print help"})
             , value<'H'>("host", &host, tag::description{"Comma-separated list of hosts"})
+            , value<'T'>("transport", &transport, tag::description{"Transport to the server: tcp, unix or shm"})
             , value<'l'>("log-level", &logLevel, tag::description{"The log level"})
             , value<'c'>("num-clients", &numClients, tag::description{"Number of Clients to run per host"})
+            , value<'i'>("in-flight", &inFlight, tag::description{"Number of transactions in flight per client"})
+            , value<'b'>("batch-size", &batchSize, tag::description{"Number of transactions sent per request"})
+            , value<'S'>("status-only", &statusOnly, tag::description{"Only request the outcome of transactions, not their results"})
             , value<'P'>("populate", &populate, tag::description{"Populate the database"})
             , value<'W'>("num-warehouses", &numWarehouses, tag::description{"Number of warehouses"})
             , value<'t'>("time", &time, tag::description{"Duration of the benchmark in seconds"})
             , value<'o'>("out", &outFile, tag::description{"Path to the output file"})
             , value<-1>("exit", &exit, tag::description{"Quit server"})
+            , value<-1>("stats", &stats, tag::description{"Print the statistics of the servers"})
             , value<'a'>("ch-bench-analytics", &useCHTables,
                          tag::description{"Populate the database witht he additional tables used in the CHBenchmark"})
             );
@@ -85,32 +170,28 @@ int main(int argc, const char** argv) {
         auto hosts = tpcc::split(host.c_str(), ',');
         io_service service;
         auto sumClients = hosts.size() * numClients;
-        std::vector<tpcc::Client> clients;
-        clients.reserve(sumClients);
-        auto wareHousesPerClient = numWarehouses / sumClients;
-        for (decltype(sumClients) i = 0; i < sumClients; ++i) {
-            if (i >= unsigned(numWarehouses)) break;
-            int16_t lastWarehouse =  wareHousesPerClient * (i + 1);
-            if (i == sumClients - 1) lastWarehouse = numWarehouses;
-            clients.emplace_back(service, numWarehouses, int16_t(wareHousesPerClient * i + 1), lastWarehouse, endTime);
-        }
+        auto trans = tpcc::transportFromString(transport);
+        std::vector<std::unique_ptr<tpcc::Stream>> streams;
+        streams.reserve(sumClients);
         for (size_t i = 0; i < hosts.size(); ++i) {
             auto h = hosts[i];
             auto addr = tpcc::split(h, ':');
             assert(addr.size() <= 2);
             auto p = addr.size() == 2 ? addr[1] : port;
-            ip::tcp::resolver resolver(service);
-            ip::tcp::resolver::iterator iter;
-            if (host == "") {
-                iter = resolver.resolve(ip::tcp::resolver::query(p));
-            } else {
-                iter = resolver.resolve(ip::tcp::resolver::query(addr[0], p));
-            }
             for (unsigned j = 0; j < numClients; ++j) {
+                streams.emplace_back(tpcc::connect(service, trans, addr[0], p));
                 LOG_INFO("Connected to client " + crossbow::to_string(i*numClients + j));
-                boost::asio::connect(clients[i*numClients + j].socket(), iter);
             }
         }
+        std::vector<tpcc::Client> clients;
+        clients.reserve(sumClients);
+        auto wareHousesPerClient = numWarehouses / sumClients;
+        for (decltype(sumClients) i = 0; i < sumClients; ++i) {
+            if (i >= unsigned(numWarehouses)) break;
+            int16_t lastWarehouse =  wareHousesPerClient * (i + 1);
+            if (i == sumClients - 1) lastWarehouse = numWarehouses;
+            clients.emplace_back(std::move(streams[i]), numWarehouses, int16_t(wareHousesPerClient * i + 1), lastWarehouse, endTime);
+        }
 
         {
             auto t = std::time(nullptr);
@@ -132,6 +213,23 @@ int main(int argc, const char** argv) {
             }
         }
 
+        if (stats) {
+            // one connection per server is enough
+            for (size_t i = 0; i < hosts.size() && i * numClients < clients.size(); ++i) {
+                auto h = hosts[i];
+                clients[i * numClients].commands().execute<tpcc::Command::STATS>(
+                        [h](const err_code& ec, const tpcc::StatsResult& res) {
+                    if (ec) {
+                        std::cerr << "ERROR: " << ec.message() << std::endl;
+                        return;
+                    }
+                    printStats(std::cout, h, res);
+                });
+            }
+            service.run();
+            return 0;
+        }
+
         if (populate) {
             auto& cmds = clients[0].commands();
             std::cout << "numWarehouses=" << numWarehouses << std::endl;
@@ -166,54 +264,54 @@ int main(int argc, const char** argv) {
         } else {
             for (decltype(clients.size()) i = 0; i < clients.size(); ++i) {
                 auto& client = clients[i];
-                client.run();
+                if (!statusOnly) {
+                    client.run(inFlight, batchSize);
+                    continue;
+                }
+                client.commands().execute<tpcc::Command::SET_RESULT_MODE>(
+                        [&client, inFlight, batchSize](const err_code& ec, tpcc::ResultMode mode) {
+                    if (ec) {
+                        LOG_ERROR(ec.message());
+                        return;
+                    }
+                    if (mode != tpcc::ResultMode::STATUS_ONLY) {
+                        LOG_WARN("Server does not support status-only results");
+                    }
+                    client.run(inFlight, batchSize);
+                }, tpcc::ResultMode::STATUS_ONLY);
             }
         }
 END:
         service.run();
         LOG_INFO("Done, writing results");
         std::ofstream out(outFile.c_str());
-        out << "start,end,transaction,success,error\n";
+        out << "start,end,transaction,success,error,abort_reason,attempts\n";
+        uint64_t commits = 0;
+        uint64_t aborts = 0;
+        uint64_t retries = 0;
         for (const auto& client : clients) {
             const auto& queue = client.log();
             for (const auto& e : queue) {
-                crossbow::string tName;
-                switch (e.transaction) {
-                case tpcc::Command::POPULATE_WAREHOUSE:
-                    tName = "Populate";
-                    break;
-                case tpcc::Command::POPULATE_DIM_TABLES:
-                    tName = "Populate";
-                    break;
-                case tpcc::Command::CREATE_SCHEMA:
-                    tName = "Schema Create";
-                    break;
-                case tpcc::Command::STOCK_LEVEL:
-                    tName = "Stock Level";
-                    break;
-                case tpcc::Command::DELIVERY:
-                    tName = "Delivery";
-                    break;
-                case tpcc::Command::NEW_ORDER:
-                    tName = "New Order";
-                    break;
-                case tpcc::Command::ORDER_STATUS:
-                    tName = "Order Status";
-                    break;
-                case tpcc::Command::PAYMENT:
-                    tName = "Payment";
-                    break;
-                case tpcc::Command::EXIT:
-                    assert(false);
-                    break;
-                }
+                auto tName = commandName(e.transaction);
                 out << std::chrono::duration_cast<std::chrono::milliseconds>(e.start - startTime).count() << ','
                     << std::chrono::duration_cast<std::chrono::milliseconds>(e.end - startTime).count() << ','
                     << tName << ','
                     << (e.success ? "true" : "false") << ','
-                    << e.error << std::endl;
+                    << e.error << ','
+                    << tpcc::abortReasonName(e.abortReason) << ','
+                    << e.attempts << std::endl;
+                if (e.success) {
+                    ++commits;
+                } else {
+                    ++aborts;
+                }
+                retries += e.attempts - 1;
             }
         }
+        // the goodput only counts committed transactions
+        auto seconds = std::chrono::duration<double>(tpcc::Clock::now() - startTime).count();
+        std::cout << commits << " commits (" << commits / seconds << "/s), " << aborts << " aborts, "
+            << retries << " server side retries\n";
         std::cout << '\a';
     } catch (std::exception& e) {
         std::cerr << e.what() << std::endl;
@@ -23,7 +23,15 @@
 #pragma once
 #include <tuple>
 #include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
 #include <type_traits>
+#include <unordered_map>
 
 #include <boost/system/error_code.hpp>
 #include <boost/asio.hpp>
@@ -32,6 +40,9 @@
 #include <crossbow/Serializer.hpp>
 #include <crossbow/string.hpp>
 
+#include "Serialization.hpp"
+#include "Transport.hpp"
+
 #define GEN_COMMANDS_ARR(Name, arr) enum class Name {\
     BOOST_PP_ARRAY_ELEM(0, arr) = 1, \
     BOOST_PP_ARRAY_ENUM(BOOST_PP_ARRAY_REMOVE(arr, 0)) \
@@ -39,29 +50,33 @@
 
 #define GEN_COMMANDS(Name, TUPLE) GEN_COMMANDS_ARR(Name, (BOOST_PP_TUPLE_SIZE(TUPLE), TUPLE))
 
-#define EXPAND_CASE(r, t) case BOOST_PP_TUPLE_ELEM(2, 0, t)::BOOST_PP_ARRAY_ELEM(0, BOOST_PP_TUPLE_ELEM(2, 1, t)): \
-    execute<BOOST_PP_TUPLE_ELEM(2, 0, t)::BOOST_PP_ARRAY_ELEM(0, BOOST_PP_TUPLE_ELEM(2, 1, t))>();\
+#define EXPAND_CASE(r, t) case BOOST_PP_TUPLE_ELEM(3, 0, t)::BOOST_PP_ARRAY_ELEM(0, BOOST_PP_TUPLE_ELEM(3, 1, t)): \
+    execute<BOOST_PP_TUPLE_ELEM(3, 0, t)::BOOST_PP_ARRAY_ELEM(0, BOOST_PP_TUPLE_ELEM(3, 1, t))> BOOST_PP_TUPLE_ELEM(3, 2, t);\
     break;
 
-#define SWITCH_PREDICATE(r, state) BOOST_PP_ARRAY_SIZE(BOOST_PP_TUPLE_ELEM(2, 1, state))
+#define SWITCH_PREDICATE(r, state) BOOST_PP_ARRAY_SIZE(BOOST_PP_TUPLE_ELEM(3, 1, state))
 
 #define SWITCH_REMOVE_ELEM(r, state) (\
-        BOOST_PP_TUPLE_ELEM(2, 0, state), \
-        BOOST_PP_ARRAY_REMOVE(BOOST_PP_TUPLE_ELEM(2, 1, state), 0) \
+        BOOST_PP_TUPLE_ELEM(3, 0, state), \
+        BOOST_PP_ARRAY_REMOVE(BOOST_PP_TUPLE_ELEM(3, 1, state), 0), \
+        BOOST_PP_TUPLE_ELEM(3, 2, state) \
         )\
 
-#define SWITCH_CASE_IMPL(Name, Param, arr) switch (Param) {\
-    BOOST_PP_FOR((Name, arr), SWITCH_PREDICATE, SWITCH_REMOVE_ELEM, EXPAND_CASE) \
+#define SWITCH_CASE_IMPL(Name, Param, arr, Args) switch (Param) {\
+    BOOST_PP_FOR((Name, arr, Args), SWITCH_PREDICATE, SWITCH_REMOVE_ELEM, EXPAND_CASE) \
 }
 
-#define SWITCH_CASE(Name, Param, t) SWITCH_CASE_IMPL(Name, Param, (BOOST_PP_TUPLE_SIZE(t), t))
+// Args is the parenthesized argument list passed to execute<Name::X>
+#define SWITCH_CASE(Name, Param, t, Args) SWITCH_CASE_IMPL(Name, Param, (BOOST_PP_TUPLE_SIZE(t), t), Args)
 
 namespace tpcc {
 
-#define COMMANDS (POPULATE_DIM_TABLES, POPULATE_WAREHOUSE, CREATE_SCHEMA, NEW_ORDER, PAYMENT, ORDER_STATUS, DELIVERY, STOCK_LEVEL, EXIT)
+#define COMMANDS (POPULATE_DIM_TABLES, POPULATE_WAREHOUSE, CREATE_SCHEMA, NEW_ORDER, PAYMENT, ORDER_STATUS, DELIVERY, STOCK_LEVEL, EXIT, BATCH, SET_RESULT_MODE, STATS)
 
 GEN_COMMANDS(Command, COMMANDS);
 
+constexpr size_t NUM_COMMANDS = BOOST_PP_TUPLE_SIZE(COMMANDS);
+
 template<Command C>
 struct Signature;
 
@@ -89,12 +104,98 @@ struct Signature<Command::EXIT> {
     using arguments = void;
 };
 
+/**
+ * How much of a transaction result the server sends back - negotiated per
+ * connection with SET_RESULT_MODE. A load generator which only looks at the
+ * outcome asks for STATUS_ONLY, the server then does not even collect the
+ * result details.
+ */
+enum class ResultMode : uint8_t {
+    FULL,
+    STATUS_ONLY
+};
+
+/**
+ * The error of transactions the server rejected because it was overloaded
+ */
+constexpr const char* SERVER_BUSY = "Server busy";
+
+/**
+ * Why a transaction did not commit - the error string carries the details
+ */
+enum class AbortReason : uint8_t {
+    NONE,
+    CONFLICT,   // write-write conflict with a concurrent transaction
+    NOT_FOUND,  // a tuple the transaction depends on does not exist
+    TIMEOUT,
+    ROLLBACK,   // the rollback of 1% of all new-order transactions the spec asks for
+    BUSY,       // rejected by the admission control
+    INVALID,    // the input violates the protocol (like the number of order lines)
+    OTHER
+};
+
+constexpr size_t NUM_ABORT_REASONS = size_t(AbortReason::OTHER) + 1;
+
+inline const char* abortReasonName(AbortReason reason) {
+    switch (reason) {
+    case AbortReason::NONE:
+        return "none";
+    case AbortReason::CONFLICT:
+        return "conflict";
+    case AbortReason::NOT_FOUND:
+        return "not found";
+    case AbortReason::TIMEOUT:
+        return "timeout";
+    case AbortReason::ROLLBACK:
+        return "rollback";
+    case AbortReason::BUSY:
+        return "busy";
+    case AbortReason::INVALID:
+        return "invalid";
+    case AbortReason::OTHER:
+        return "other";
+    }
+    return "";
+}
+
+template<>
+struct Signature<Command::SET_RESULT_MODE> {
+    using result = ResultMode; // the mode the server applies from now on
+    using arguments = ResultMode;
+};
+
+// an order has between 5 and 15 lines
+constexpr size_t MAX_ORDER_LINES = 15;
+
+// the item table holds the ids 1 to NUM_ITEMS
+constexpr int32_t NUM_ITEMS = 100000;
+
+/**
+ * The order lines are generated by the client (clause 2.4.1.5). In 1% of the
+ * orders the last line refers to the unused item NUM_ITEMS + 1, the server
+ * rolls back as soon as it looks that item up.
+ */
 struct NewOrderIn {
+    struct OrderLine {
+        int32_t ol_i_id;
+        int16_t ol_supply_w_id;
+        int16_t ol_quantity;
+    };
     int16_t w_id;
     int16_t d_id;
     int32_t c_id;
+    int16_t o_ol_cnt;
+    OrderLine lines[MAX_ORDER_LINES];
 };
 
+/**
+ * The spec asks for 5 to 15 lines, but the server only relies on the lines
+ * fitting into NewOrderIn::lines - it uses o_ol_cnt as loop bound.
+ */
+inline bool validOrderLineCount(const NewOrderIn& in) {
+    return in.o_ol_cnt >= 1 && size_t(in.o_ol_cnt) <= MAX_ORDER_LINES;
+}
+
 struct NewOrderResult {
     using is_serializable = crossbow::is_serializable;
     struct OrderLine {
@@ -122,7 +223,12 @@ struct NewOrderResult {
     };
     bool success = true;
     crossbow::string error;
+    AbortReason abortReason = AbortReason::NONE;
+    // how often the server executed the transaction, including the last time
+    uint16_t attempts = 1;
     int32_t o_id;
+    // only success, error and o_id are set
+    bool statusOnly = false;
     int16_t o_ol_cnt;
     crossbow::string c_last;
     crossbow::string c_credit;
@@ -137,7 +243,13 @@ struct NewOrderResult {
     void operator&(Archiver& ar) {
         ar & success;
         ar & error;
+        ar & abortReason;
+        ar & attempts;
         ar & o_id;
+        ar & statusOnly;
+        if (statusOnly) {
+            return;
+        }
         ar & o_ol_cnt;
         ar & c_last;
         ar & c_credit;
@@ -184,11 +296,15 @@ struct PaymentResult {
     using is_serializable = crossbow::is_serializable;
     bool success = true;
     crossbow::string error;
+    AbortReason abortReason = AbortReason::NONE;
+    uint16_t attempts = 1;
 
     template<class Archiver>
     void operator&(Archiver& ar) {
         ar & success;
         ar & error;
+        ar & abortReason;
+        ar & attempts;
     }
 };
 
@@ -220,11 +336,15 @@ struct OrderStatusResult {
     using is_serializable = crossbow::is_serializable;
     bool success;
     crossbow::string error;
+    AbortReason abortReason = AbortReason::NONE;
+    uint16_t attempts = 1;
 
     template<class A>
     void operator&(A& ar) {
         ar & success;
         ar & error;
+        ar & abortReason;
+        ar & attempts;
     }
 };
 
@@ -243,12 +363,16 @@ struct DeliveryResult {
     using is_serializable = crossbow::is_serializable;
     bool success;
     crossbow::string error;
+    AbortReason abortReason = AbortReason::NONE;
+    uint16_t attempts = 1;
     int32_t low_stock;
 
     template<class A>
     void operator& (A& ar) {
         ar & success;
         ar & error;
+        ar & abortReason;
+        ar & attempts;
         ar & low_stock;
     }
 };
@@ -269,12 +393,16 @@ struct StockLevelResult {
     using is_serializable = crossbow::is_serializable;
     bool success;
     crossbow::string error;
+    AbortReason abortReason = AbortReason::NONE;
+    uint16_t attempts = 1;
     int32_t low_stock;
 
     template<class A>
     void operator& (A& ar) {
         ar & success;
         ar & error;
+        ar & abortReason;
+        ar & attempts;
         ar & low_stock;
     }
 };
@@ -285,6 +413,241 @@ struct Signature<Command::STOCK_LEVEL> {
     using result = StockLevelResult;
 };
 
+/**
+ * Input of one of the five TPC-C transactions, only the member selected by
+ * command is sent over the wire.
+ */
+struct TransactionIn {
+    using is_serializable = crossbow::is_serializable;
+    Command command;
+    NewOrderIn newOrder;
+    PaymentIn payment;
+    OrderStatusIn orderStatus;
+    DeliveryIn delivery;
+    StockLevelIn stockLevel;
+
+    template<class A>
+    void operator& (A& ar) {
+        ar & command;
+        switch (command) {
+        case Command::NEW_ORDER:
+            ar & newOrder;
+            break;
+        case Command::PAYMENT:
+            ar & payment;
+            break;
+        case Command::ORDER_STATUS:
+            ar & orderStatus;
+            break;
+        case Command::DELIVERY:
+            ar & delivery;
+            break;
+        case Command::STOCK_LEVEL:
+            ar & stockLevel;
+            break;
+        default:
+            break;
+        }
+    }
+};
+
+struct TransactionResult {
+    using is_serializable = crossbow::is_serializable;
+    Command command;
+    NewOrderResult newOrder;
+    PaymentResult payment;
+    OrderStatusResult orderStatus;
+    DeliveryResult delivery;
+    StockLevelResult stockLevel;
+
+    bool success() const {
+        switch (command) {
+        case Command::NEW_ORDER:
+            return newOrder.success;
+        case Command::PAYMENT:
+            return payment.success;
+        case Command::ORDER_STATUS:
+            return orderStatus.success;
+        case Command::DELIVERY:
+            return delivery.success;
+        case Command::STOCK_LEVEL:
+            return stockLevel.success;
+        default:
+            return false;
+        }
+    }
+
+    const crossbow::string& error() const {
+        switch (command) {
+        case Command::NEW_ORDER:
+            return newOrder.error;
+        case Command::PAYMENT:
+            return payment.error;
+        case Command::ORDER_STATUS:
+            return orderStatus.error;
+        case Command::DELIVERY:
+            return delivery.error;
+        default:
+            return stockLevel.error;
+        }
+    }
+
+    AbortReason abortReason() const {
+        switch (command) {
+        case Command::NEW_ORDER:
+            return newOrder.abortReason;
+        case Command::PAYMENT:
+            return payment.abortReason;
+        case Command::ORDER_STATUS:
+            return orderStatus.abortReason;
+        case Command::DELIVERY:
+            return delivery.abortReason;
+        default:
+            return stockLevel.abortReason;
+        }
+    }
+
+    uint16_t attempts() const {
+        switch (command) {
+        case Command::NEW_ORDER:
+            return newOrder.attempts;
+        case Command::PAYMENT:
+            return payment.attempts;
+        case Command::ORDER_STATUS:
+            return orderStatus.attempts;
+        case Command::DELIVERY:
+            return delivery.attempts;
+        default:
+            return stockLevel.attempts;
+        }
+    }
+
+    template<class A>
+    void operator& (A& ar) {
+        ar & command;
+        switch (command) {
+        case Command::NEW_ORDER:
+            ar & newOrder;
+            break;
+        case Command::PAYMENT:
+            ar & payment;
+            break;
+        case Command::ORDER_STATUS:
+            ar & orderStatus;
+            break;
+        case Command::DELIVERY:
+            ar & delivery;
+            break;
+        case Command::STOCK_LEVEL:
+            ar & stockLevel;
+            break;
+        default:
+            break;
+        }
+    }
+};
+
+/**
+ * Executes several transactions with one request, the server runs them one
+ * after the other and answers with all results at once.
+ */
+template<>
+struct Signature<Command::BATCH> {
+    using arguments = std::vector<TransactionIn>;
+    using result = std::vector<TransactionResult>;
+};
+
+/**
+ * Server side counters of one command type
+ */
+struct CommandStats {
+    using is_serializable = crossbow::is_serializable;
+    // bucket i counts the transactions which took less than 2^(i+1)
+    // microseconds (and at least 2^i for i > 0) inside the server
+    static constexpr size_t NUM_BUCKETS = 32;
+
+    Command command;
+    uint64_t commits = 0;
+    uint64_t aborts = 0;
+    // aborted attempts the server retried on its own, not counted in aborts
+    uint64_t retries = 0;
+    // round trips to the storage on the critical path, summed over all commits
+    uint64_t criticalPath = 0;
+    // only reasons which occurred at least once
+    std::vector<std::pair<AbortReason, uint64_t>> abortReasons;
+    // trailing empty buckets are not sent
+    std::vector<uint64_t> latencyHistogram;
+
+    template<class A>
+    void operator&(A& ar) {
+        ar & command;
+        ar & commits;
+        ar & aborts;
+        ar & retries;
+        ar & criticalPath;
+        ar & abortReasons;
+        ar & latencyHistogram;
+    }
+};
+
+struct StatsResult {
+    using is_serializable = crossbow::is_serializable;
+    // transactions currently running and waiting for admission
+    uint64_t running = 0;
+    uint64_t queued = 0;
+    // only command types which were executed at least once
+    std::vector<CommandStats> commands;
+
+    template<class A>
+    void operator&(A& ar) {
+        ar & running;
+        ar & queued;
+        ar & commands;
+    }
+};
+
+/**
+ * Live counters of the whole server process since it started
+ */
+template<>
+struct Signature<Command::STATS> {
+    using arguments = void;
+    using result = StatsResult;
+};
+
+namespace impl {
+
+// Version of the wire format - has to be increased whenever the layout of a
+// message changes, especially of a type sent with is_pod_wire
+constexpr uint32_t WIRE_VERSION = 7;
+constexpr size_t FRAME_ALIGNMENT = 8;
+
+}
+
+/**
+ * Types which are trivially copyable (like NewOrderIn) are sent in their
+ * in-memory layout and the receiver uses them in place from its receive buffer
+ * instead of decoding them into a copy. Everything with an operator& (strings,
+ * vectors) goes through the field-wise encoding of BufferWriter/BufferReader.
+ */
+template<class T, class Enable = void>
+struct is_pod_wire : std::false_type {};
+
+template<class T>
+struct is_pod_wire<T, typename std::enable_if<
+        std::is_trivially_copyable<T>::value && !impl::has_serializable<T>::value>::type>
+    : std::integral_constant<bool, alignof(T) <= impl::FRAME_ALIGNMENT> {};
+
+template<Command C>
+struct WireTraits {
+    static constexpr bool podArguments = is_pod_wire<typename Signature<C>::arguments>::value;
+    static constexpr bool podResult = is_pod_wire<typename Signature<C>::result>::value;
+};
+
+static_assert(WireTraits<Command::NEW_ORDER>::podArguments, "NewOrderIn has to be sent in place");
+static_assert(WireTraits<Command::DELIVERY>::podArguments, "DeliveryIn has to be sent in place");
+static_assert(WireTraits<Command::STOCK_LEVEL>::podArguments, "StockLevelIn has to be sent in place");
+
 namespace impl {
 
 template<class... Args>
@@ -307,6 +670,98 @@ struct ArgSerializer<> {
     void exec(C&) const {}
 };
 
+// Every frame starts with its total size (including the header) followed by
+// the id of the request. Requests additionally carry the command and the wire
+// version, responses carry the id of the request they answer - they can be
+// sent in any order. Frames are padded to FRAME_ALIGNMENT so that the payload
+// of every frame in a receive buffer is properly aligned.
+constexpr size_t RESPONSE_HEADER_SIZE = sizeof(size_t) + sizeof(uint64_t);
+constexpr size_t REQUEST_HEADER_SIZE = RESPONSE_HEADER_SIZE + sizeof(Command) + sizeof(uint32_t);
+static_assert(REQUEST_HEADER_SIZE % FRAME_ALIGNMENT == 0, "Request payload has to be aligned");
+static_assert(RESPONSE_HEADER_SIZE % FRAME_ALIGNMENT == 0, "Response payload has to be aligned");
+
+// No frame - not even a big batch - comes close to this, anything larger is a
+// corrupt size the receive buffer must not grow to
+constexpr size_t MAX_FRAME_SIZE = size_t(64) << 20;
+
+/**
+ * A frame has to hold at least its header, and endFrame pads it to the
+ * alignment - a size violating this means the peer is broken and the stream
+ * is out of sync.
+ */
+inline bool validFrameSize(size_t size, size_t headerSize) {
+    return size >= headerSize && size <= MAX_FRAME_SIZE && size % FRAME_ALIGNMENT == 0;
+}
+
+inline size_t frameSize(const uint8_t* frame) {
+    return *reinterpret_cast<const size_t*>(frame);
+}
+
+inline uint64_t frameId(const uint8_t* frame) {
+    return *reinterpret_cast<const uint64_t*>(frame + sizeof(size_t));
+}
+
+/**
+ * Appends the header of a new frame to buffer - the size gets filled in by
+ * endFrame once the body is written. Returns the offset of the frame.
+ */
+inline size_t beginFrame(Buffer& buffer, uint64_t id) {
+    auto offset = buffer.size();
+    buffer.grow(sizeof(size_t));
+    memcpy(buffer.grow(sizeof(id)), &id, sizeof(id));
+    return offset;
+}
+
+inline void endFrame(Buffer& buffer, size_t offset) {
+    size_t size = buffer.size() - offset;
+    if (size % FRAME_ALIGNMENT != 0) {
+        auto padding = FRAME_ALIGNMENT - size % FRAME_ALIGNMENT;
+        buffer.grow(padding);
+        size += padding;
+    }
+    memcpy(buffer.data() + offset, &size, sizeof(size));
+}
+
+/**
+ * Checks that a request names an existing command and that its frame holds
+ * the arguments the server uses in place - the serialized ones are checked
+ * against the frame while they get decoded.
+ */
+class RequestCheck {
+    size_t mSize;
+    bool mValid = false;
+
+    template<Command C>
+    typename std::enable_if<WireTraits<C>::podArguments, void>::type
+    execute() {
+        mValid = mSize >= REQUEST_HEADER_SIZE + sizeof(typename Signature<C>::arguments);
+    }
+
+    template<Command C>
+    typename std::enable_if<!WireTraits<C>::podArguments, void>::type
+    execute() {
+        mValid = true;
+    }
+public:
+    explicit RequestCheck(size_t size)
+        : mSize(size)
+    {}
+
+    bool valid(Command cmd) {
+        SWITCH_CASE(Command, cmd, COMMANDS, ())
+        return mValid;
+    }
+};
+
+/**
+ * Makes sure the frame at the beginning of buffer fits into it
+ */
+inline void reserveFrame(Buffer& buffer) {
+    if (buffer.size() >= sizeof(size_t)) {
+        buffer.reserve(frameSize(buffer.data()));
+    }
+}
+
 }
 
 namespace client {
@@ -326,104 +781,188 @@ struct argsType<> {
     using type = void;
 };
 
+/**
+ * Client side of the protocol.
+ *
+ * Any number of requests can be in flight at the same time, responses are
+ * matched to their callbacks by the request id. Requests issued while a write
+ * is in progress get collected and sent with the next write.
+ */
 class CommandsImpl {
-    boost::asio::ip::tcp::socket& mSocket;
-    size_t mCurrSize = 1024;
-    std::unique_ptr<uint8_t[]> mCurrentRequest;
+    using error_code = boost::system::error_code;
+    // Gets the response frame and its end, returns false if the response could
+    // not be decoded - the callback then already got a bad_message error
+    using ResponseHandler = std::function<bool(const error_code&, const uint8_t*, const uint8_t*)>;
+    Stream& mStream;
+    uint64_t mNextId = 0;
+    std::unordered_map<uint64_t, ResponseHandler> mPending;
+    Buffer mReceiveBuffer;
+    bool mReading = false;
+    Buffer mSendBuffer;
+    Buffer mWriteBuffer;
+    bool mSending = false;
 public:
-    CommandsImpl(boost::asio::ip::tcp::socket& socket)
-        : mSocket(socket), mCurrentRequest(new uint8_t[mCurrSize])
+    CommandsImpl(Stream& stream)
+        : mStream(stream)
     {
     }
 
-    template<class Callback, class Result>
-    typename std::enable_if<std::is_void<Result>::value, void>::type
-    readResponse(const Callback& callback, size_t bytes_read = 0) {
-        assert(bytes_read <= 1);
-        if (bytes_read) {
-            boost::system::error_code noError;
-            callback(noError);
+    size_t numPending() const {
+        return mPending.size();
+    }
+
+    template<Command C, class Callback, class... Args>
+    void execute(const Callback& callback, const Args&... args) {
+        static_assert(
+                (std::is_void<typename Signature<C>::arguments>::value && std::is_void<argsType<Args...>>::value) ||
+                std::is_same<typename Signature<C>::arguments, typename argsType<Args...>::type>::value,
+                "Wrong function arguments");
+        using ResType = typename Signature<C>::result;
+        auto id = ++mNextId;
+        auto offset = impl::beginFrame(mSendBuffer, id);
+        BufferWriter writer(mSendBuffer);
+        writer & C;
+        writer & impl::WIRE_VERSION;
+        impl::ArgSerializer<Args...> argSerializer;
+        argSerializer.exec(writer, args...);
+        impl::endFrame(mSendBuffer, offset);
+        mPending.emplace(id, [callback](const error_code& ec, const uint8_t* response, const uint8_t* end) {
+            return handleResponse<ResType>(ec, response, end, callback);
+        });
+        send();
+        read();
+    }
+
+private:
+    template<class Result, class Callback>
+    static typename std::enable_if<std::is_void<Result>::value, bool>::type
+    handleResponse(const error_code& ec, const uint8_t*, const uint8_t*, const Callback& callback) {
+        callback(ec);
+        return true;
+    }
+
+    template<class Result, class Callback>
+    static typename std::enable_if<!std::is_void<Result>::value && is_pod_wire<Result>::value, bool>::type
+    handleResponse(const error_code& ec, const uint8_t* response, const uint8_t* end, const Callback& callback) {
+        Result res;
+        if (ec) {
+            callback(ec, res);
+            return true;
+        }
+        if (size_t(end - response) < impl::RESPONSE_HEADER_SIZE + sizeof(Result)) {
+            callback(boost::system::errc::make_error_code(boost::system::errc::bad_message), res);
+            return false;
+        }
+        callback(ec, *reinterpret_cast<const Result*>(response + impl::RESPONSE_HEADER_SIZE));
+        return true;
+    }
+
+    template<class Result, class Callback>
+    static typename std::enable_if<!std::is_void<Result>::value && !is_pod_wire<Result>::value, bool>::type
+    handleResponse(const error_code& ec, const uint8_t* response, const uint8_t* end, const Callback& callback) {
+        Result res;
+        if (ec) {
+            callback(ec, res);
+            return true;
+        }
+        BufferReader reader(response + impl::RESPONSE_HEADER_SIZE, end);
+        reader & res;
+        if (!reader.ok()) {
+            callback(boost::system::errc::make_error_code(boost::system::errc::bad_message), Result());
+            return false;
+        }
+        callback(ec, res);
+        return true;
+    }
+
+    void send() {
+        if (mSending || mSendBuffer.empty()) {
+            return;
         }
-        mSocket.async_read_some(boost::asio::buffer(mCurrentRequest.get(), mCurrSize),
-                [this, callback, bytes_read](const boost::system::error_code& ec, size_t br){
+        mSending = true;
+        std::swap(mSendBuffer, mWriteBuffer);
+        mStream.asyncWrite(mWriteBuffer.data(), mWriteBuffer.size(),
+                [this](const error_code& ec, size_t) {
+                    mSending = false;
+                    mWriteBuffer.clear();
                     if (ec) {
-                        error<Result>(ec, callback);
+                        fail(ec);
                         return;
                     }
-                    readResponse<Callback, Result>(callback, bytes_read + br);
+                    send();
                 });
     }
 
-    template<class Callback, class Result>
-    typename std::enable_if<!std::is_void<Result>::value, void>::type
-    readResponse(const Callback& callback, size_t bytes_read = 0) {
-        auto respSize = *reinterpret_cast<size_t*>(mCurrentRequest.get());
-        if (bytes_read >= 8 && respSize == bytes_read) {
-            // response read
-            Result res;
-            boost::system::error_code noError;
-            crossbow::deserializer ser(mCurrentRequest.get() + sizeof(size_t));
-            ser & res;
-            callback(noError, res);
+    void read() {
+        // we only keep a read outstanding while we are waiting for responses,
+        // otherwise the io_service would never run out of work
+        if (mReading || mPending.empty()) {
             return;
-        } else if (bytes_read >= 8 && respSize > mCurrSize) {
-            std::unique_ptr<uint8_t[]> newBuf(new uint8_t[respSize]);
-            memcpy(newBuf.get(), mCurrentRequest.get(), mCurrSize);
-            mCurrentRequest.swap(newBuf);
         }
-        mSocket.async_read_some(boost::asio::buffer(mCurrentRequest.get() + bytes_read, mCurrSize - bytes_read),
-                [this, callback, bytes_read](const boost::system::error_code& ec, size_t br){
+        mReading = true;
+        auto size = mReceiveBuffer.size();
+        mStream.asyncReadSome(mReceiveBuffer.data() + size, mReceiveBuffer.capacity() - size,
+                [this](const error_code& ec, size_t br) {
                     if (ec) {
-                        Result res;
-                        callback(ec, res);
+                        mReading = false;
+                        fail(ec);
                         return;
                     }
-                    readResponse<Callback, Result>(callback, bytes_read + br);
+                    mReceiveBuffer.resize(mReceiveBuffer.size() + br);
+                    processResponses();
+                    mReading = false;
+                    read();
                 });
     }
 
-    template<class Res, class Callback>
-    typename std::enable_if<std::is_void<Res>::value, void>::type
-    error(const boost::system::error_code& ec, const Callback& callback) {
-        callback(ec);
+    void processResponses() {
+        size_t offset = 0;
+        auto bytesRead = mReceiveBuffer.size();
+        // the size gets checked as soon as it is there, reserveFrame relies on it
+        while (bytesRead - offset >= sizeof(size_t)) {
+            auto frame = mReceiveBuffer.data() + offset;
+            auto respSize = impl::frameSize(frame);
+            if (!impl::validFrameSize(respSize, impl::RESPONSE_HEADER_SIZE)) {
+                protocolError();
+                return;
+            }
+            if (bytesRead - offset < respSize) {
+                break;
+            }
+            auto iter = mPending.find(impl::frameId(frame));
+            if (iter == mPending.end()) {
+                protocolError();
+                return;
+            }
+            auto handler = std::move(iter->second);
+            mPending.erase(iter);
+            if (!handler(error_code(), frame, frame + respSize)) {
+                protocolError();
+                return;
+            }
+            offset += respSize;
+        }
+        mReceiveBuffer.consume(offset);
+        impl::reserveFrame(mReceiveBuffer);
     }
 
-    template<class Res, class Callback>
-    typename std::enable_if<!std::is_void<Res>::value, void>::type
-    error(const boost::system::error_code& ec, const Callback& callback) {
-        Res res;
-        callback(ec, res);
+    /**
+     * The server sent something we can not make sense of - nothing after it can
+     * be trusted, so the stream gets closed and all requests fail.
+     */
+    void protocolError() {
+        mReceiveBuffer.clear();
+        error_code ec;
+        mStream.close(ec);
+        fail(boost::system::errc::make_error_code(boost::system::errc::bad_message));
     }
 
-    template<Command C, class Callback, class... Args>
-    void execute(const Callback& callback, const Args&... args) {
-        static_assert(
-                (std::is_void<typename Signature<C>::arguments>::value && std::is_void<argsType<Args...>>::value) ||
-                std::is_same<typename Signature<C>::arguments, typename argsType<Args...>::type>::value,
-                "Wrong function arguments");
-        using ResType = typename Signature<C>::result;
-        crossbow::sizer sizer;
-        sizer & sizer.size;
-        sizer & C;
-        impl::ArgSerializer<Args...> argSerializer;
-        argSerializer.exec(sizer, args...);
-        if (mCurrSize < sizer.size) {
-            mCurrentRequest.reset(new uint8_t[sizer.size]);
-            mCurrSize = sizer.size;
-        }
-        crossbow::serializer ser(mCurrentRequest.get());
-        ser & sizer.size;
-        ser & C;
-        argSerializer.exec(ser, args...);
-        ser.buffer.release();
-        boost::asio::async_write(mSocket, boost::asio::buffer(mCurrentRequest.get(), sizer.size),
-                    [this, callback](const boost::system::error_code& ec, size_t){
-                        if (ec) {
-                            error<ResType>(ec, callback);
-                            return;
-                        }
-                        readResponse<Callback, ResType>(callback);
-                    });
+    void fail(const error_code& ec) {
+        decltype(mPending) pending;
+        pending.swap(mPending);
+        for (auto& p : pending) {
+            p.second(ec, nullptr, nullptr);
+        }
     }
 };
 
@@ -431,121 +970,396 @@ public:
 
 namespace server {
 
+/**
+ * Server side of the protocol.
+ *
+ * Requests are dispatched to the implementation as soon as they are read, so
+ * several of them can be in flight on the same connection. The implementation
+ * can limit this with maxPending - the server then stops reading from the
+ * stream until a response got scheduled.
+ *
+ * All handlers of a connection have to run on the same thread, this also
+ * holds for the callbacks passed to the implementation. Responses get
+ * serialized directly into the send buffer and all responses which completed
+ * while a write was in progress are sent with the next write. None of the
+ * buffers ever shrink, so a connection stops allocating once it has seen its
+ * largest frame.
+ */
 template<class Implementation>
 class Server {
     Implementation& mImpl;
-    boost::asio::ip::tcp::socket& mSocket;
-    size_t mBufSize = 1024;
-    std::unique_ptr<uint8_t[]> mBuffer;
+    Stream& mStream;
+    size_t mMaxPending;
+    size_t mPending = 0;
+    Buffer mReceiveBuffer;
+    bool mReading = false;
+    Buffer mSendBuffer;
+    Buffer mWriteBuffer;
+    bool mSending = false;
     using error_code = boost::system::error_code;
     bool doQuit = false;
+    std::function<void()> mOnQuit;
+    bool mClosed = false;
 public:
-    Server(Implementation& impl, boost::asio::ip::tcp::socket& socket)
+    Server(Implementation& impl, Stream& stream,
+            size_t maxPending = std::numeric_limits<size_t>::max())
         : mImpl(impl)
-        , mSocket(socket)
-        , mBuffer(new uint8_t[mBufSize])
+        , mStream(stream)
+        , mMaxPending(maxPending)
     {}
     void run() {
         read();
     }
     void quit() {
+        quit([this]() {
+            mStream.service().stop();
+        });
+    }
+    /**
+     * Stops serving requests, onQuit gets called as soon as all pending
+     * responses are written.
+     */
+    void quit(std::function<void()> onQuit) {
         doQuit = true;
+        mOnQuit = std::move(onQuit);
     }
 private:
     template<Command C, class Callback>
     typename std::enable_if<std::is_void<typename Signature<C>::arguments>::value, void>::type
-    execute(Callback callback) {
+    execute(const uint8_t*, const uint8_t*, Callback callback) {
         mImpl.template execute<C>(callback);
     }
 
+    // The arguments point into the receive buffer, so the implementation has
+    // to copy them if it needs them after execute returned
+    template<Command C, class Callback>
+    typename std::enable_if<WireTraits<C>::podArguments, void>::type
+    execute(const uint8_t* request, const uint8_t*, Callback callback) {
+        using Args = typename Signature<C>::arguments;
+        const auto& args = *reinterpret_cast<const Args*>(request + impl::REQUEST_HEADER_SIZE);
+        if (rejectInvalid(args, callback)) {
+            return;
+        }
+        mImpl.template execute<C>(args, callback);
+    }
+
+    /**
+     * Answers requests whose arguments the implementations can not handle
+     * safely with an INVALID error - returns true if it did so.
+     */
+    template<class Callback>
+    static bool rejectInvalid(const NewOrderIn& args, const Callback& callback) {
+        if (validOrderLineCount(args)) {
+            return false;
+        }
+        NewOrderResult res;
+        res.success = false;
+        res.error = "Invalid number of order lines: " + crossbow::to_string(args.o_ol_cnt);
+        res.abortReason = AbortReason::INVALID;
+        callback(res);
+        return true;
+    }
+
+    template<class Args, class Callback>
+    static bool rejectInvalid(const Args&, const Callback&) {
+        return false;
+    }
+
     template<Command C, class Callback>
-    typename std::enable_if<!std::is_void<typename Signature<C>::arguments>::value, void>::type
-    execute(Callback callback) {
+    typename std::enable_if<!std::is_void<typename Signature<C>::arguments>::value && !WireTraits<C>::podArguments,
+            void>::type
+    execute(const uint8_t* request, const uint8_t* end, Callback callback) {
         using Args = typename Signature<C>::arguments;
         Args args;
-        crossbow::deserializer des(mBuffer.get() + sizeof(size_t) + sizeof(Command));
-        des & args;
+        BufferReader reader(request + impl::REQUEST_HEADER_SIZE, end);
+        reader & args;
+        if (!reader.ok()) {
+            rejectMalformed();
+            return;
+        }
         mImpl.template execute<C>(args, callback);
     }
 
+    /**
+     * The arguments of a request do not fit into its frame - the client is
+     * broken, so the request gets dropped and the connection closed.
+     */
+    void rejectMalformed() {
+        --mPending;
+        std::cerr << "Client sent malformed arguments" << std::endl;
+        close();
+    }
+
     template<Command C>
-    typename std::enable_if<std::is_void<typename Signature<C>::result>::value, void>::type execute() {
-        execute<C>([this]() {
-            // send the result back
-            mBuffer[0] = 1;
-            boost::asio::async_write(mSocket,
-                    boost::asio::buffer(mBuffer.get(), 1),
-                    [this](const error_code& ec, size_t bytes_written) {
-                        if (ec) {
-                            std::cerr << ec.message() << std::endl;
-                            return;
-                        }
-                        read(0);
-                    }
-            );
+    typename std::enable_if<C != Command::BATCH && std::is_void<typename Signature<C>::result>::value, void>::type
+    execute(uint64_t id, const uint8_t* request, const uint8_t* end) {
+        ++mPending;
+        execute<C>(request, end, [this, id]() {
+            if (!complete()) {
+                return;
+            }
+            // send an empty response back
+            auto offset = impl::beginFrame(mSendBuffer, id);
+            impl::endFrame(mSendBuffer, offset);
+            send();
+            read();
         });
     }
 
     template<Command C>
-    typename std::enable_if<!std::is_void<typename Signature<C>::result>::value, void>::type execute() {
+    typename std::enable_if<C != Command::BATCH && !std::is_void<typename Signature<C>::result>::value, void>::type
+    execute(uint64_t id, const uint8_t* request, const uint8_t* end) {
         using Res = typename Signature<C>::result;
-        execute<C>([this](const Res& result) {
-            // Serialize result
-            crossbow::sizer sizer;
-            sizer & sizer.size;
-            sizer & result;
-            if (mBufSize < sizer.size) {
-                mBuffer.reset(new uint8_t[sizer.size]);
+        ++mPending;
+        execute<C>(request, end, [this, id](const Res& result) {
+            if (!complete()) {
+                return;
             }
-            crossbow::serializer ser(mBuffer.get());
-            ser & sizer.size;
-            ser & result;
-            ser.buffer.release();
-            // send the result back
-            boost::asio::async_write(mSocket,
-                    boost::asio::buffer(mBuffer.get(), sizer.size),
-                    [this](const error_code& ec, size_t bytes_written) {
-                        if (ec) {
-                            std::cerr << ec.message() << std::endl;
-                            mSocket.close();
-                            mImpl.close();
-                            return;
-                        }
-                        read(0);
-                    }
-            );
+            respond(id, result);
         });
     }
-    void read(size_t bytes_read = 0) {
-        if (bytes_read == 0 && doQuit) {
-            mSocket.get_io_service().stop();
+
+    template<class Res>
+    void respond(uint64_t id, const Res& result) {
+        auto offset = impl::beginFrame(mSendBuffer, id);
+        BufferWriter writer(mSendBuffer);
+        writer & result;
+        impl::endFrame(mSendBuffer, offset);
+        send();
+        read();
+    }
+
+    struct Batch {
+        uint64_t id;
+        typename Signature<Command::BATCH>::arguments args;
+        typename Signature<Command::BATCH>::result results;
+        size_t next = 0;
+        bool running = false;
+        bool completed = false;
+    };
+
+    /**
+     * Batches are executed by the server itself: the implementation only sees
+     * the single transactions, one at a time and in the order of the batch.
+     */
+    template<Command C>
+    typename std::enable_if<C == Command::BATCH, void>::type
+    execute(uint64_t id, const uint8_t* request, const uint8_t* end) {
+        ++mPending;
+        auto batch = std::make_shared<Batch>();
+        batch->id = id;
+        BufferReader reader(request + impl::REQUEST_HEADER_SIZE, end);
+        reader & batch->args;
+        if (!reader.ok()) {
+            rejectMalformed();
+            return;
+        }
+        batch->results.resize(batch->args.size());
+        runBatch(batch);
+    }
+
+    void runBatch(const std::shared_ptr<Batch>& batch) {
+        // Transactions completing synchronously are handled in this loop
+        // instead of recursing from their callbacks
+        while (!mClosed && batch->next < batch->args.size()) {
+            batch->running = true;
+            batch->completed = false;
+            executeBatchEntry(batch, batch->next);
+            batch->running = false;
+            if (!batch->completed) {
+                // continues from the callback
+                return;
+            }
+            ++batch->next;
+        }
+        if (!complete()) {
+            return;
+        }
+        respond(batch->id, batch->results);
+    }
+
+    void batchEntryDone(const std::shared_ptr<Batch>& batch) {
+        if (batch->running) {
+            batch->completed = true;
+            return;
+        }
+        ++batch->next;
+        runBatch(batch);
+    }
+
+    void executeBatchEntry(const std::shared_ptr<Batch>& batch, size_t i) {
+        const auto& entry = batch->args[i];
+        auto& result = batch->results[i];
+        result.command = entry.command;
+        switch (entry.command) {
+        case Command::NEW_ORDER:
+            {
+                auto callback = [this, batch, &result](const NewOrderResult& res) {
+                    result.newOrder = res;
+                    batchEntryDone(batch);
+                };
+                if (!rejectInvalid(entry.newOrder, callback)) {
+                    mImpl.template execute<Command::NEW_ORDER>(entry.newOrder, callback);
+                }
+            }
+            break;
+        case Command::PAYMENT:
+            mImpl.template execute<Command::PAYMENT>(entry.payment, [this, batch, &result](const PaymentResult& res) {
+                result.payment = res;
+                batchEntryDone(batch);
+            });
+            break;
+        case Command::ORDER_STATUS:
+            mImpl.template execute<Command::ORDER_STATUS>(entry.orderStatus,
+                    [this, batch, &result](const OrderStatusResult& res) {
+                result.orderStatus = res;
+                batchEntryDone(batch);
+            });
+            break;
+        case Command::DELIVERY:
+            mImpl.template execute<Command::DELIVERY>(entry.delivery, [this, batch, &result](const DeliveryResult& res) {
+                result.delivery = res;
+                batchEntryDone(batch);
+            });
+            break;
+        case Command::STOCK_LEVEL:
+            mImpl.template execute<Command::STOCK_LEVEL>(entry.stockLevel,
+                    [this, batch, &result](const StockLevelResult& res) {
+                result.stockLevel = res;
+                batchEntryDone(batch);
+            });
+            break;
+        default:
+            std::cerr << "Only transactions can be batched" << std::endl;
+            batchEntryDone(batch);
+        }
+    }
+
+    /**
+     * Marks a request as done - returns false if the connection got closed in
+     * the meantime and the response has to be dropped.
+     */
+    bool complete() {
+        --mPending;
+        if (mClosed) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void send() {
+        if (mSending || mSendBuffer.empty()) {
+            return;
+        }
+        mSending = true;
+        std::swap(mSendBuffer, mWriteBuffer);
+        mStream.asyncWrite(mWriteBuffer.data(), mWriteBuffer.size(),
+                [this](const error_code& ec, size_t bytes_written) {
+                    mSending = false;
+                    mWriteBuffer.clear();
+                    if (ec) {
+                        std::cerr << ec.message() << std::endl;
+                        close();
+                        return;
+                    }
+                    if (mClosed) {
+                        close();
+                        return;
+                    }
+                    if (doQuit && mSendBuffer.empty()) {
+                        mOnQuit();
+                        return;
+                    }
+                    send();
+                }
+        );
+    }
+
+    void read() {
+        if (mReading || mClosed || doQuit) {
+            return;
         }
-        size_t reqSize = 0;
-        if (bytes_read != 0) {
-            reqSize = *reinterpret_cast<size_t*>(mBuffer.get());
+        // mReading also protects against reentrance from synchronous callbacks
+        mReading = true;
+        processRequests();
+        mReading = false;
+        if (mClosed) {
+            close();
+            return;
         }
-        if (bytes_read != 0 && reqSize == bytes_read) {
-            // done reading
-            auto cmd = *reinterpret_cast<Command*>(mBuffer.get() + sizeof(size_t));
-            SWITCH_CASE(Command, cmd, COMMANDS)
+        if (doQuit || mPending >= mMaxPending) {
+            // reading resumes as soon as a request completes
             return;
-        } else if (bytes_read >= 8 && reqSize > mBufSize) {
-            std::unique_ptr<uint8_t[]> newBuf(new uint8_t[reqSize]);
-            memcpy(newBuf.get(), mBuffer.get(), mBufSize);
-            mBuffer.swap(newBuf);
-            mBufSize = reqSize;
-        }
-        mSocket.async_read_some(boost::asio::buffer(mBuffer.get() + bytes_read, mBufSize - bytes_read),
-                [this, bytes_read](const error_code& ec, size_t br){
+        }
+        mReading = true;
+        auto size = mReceiveBuffer.size();
+        mStream.asyncReadSome(mReceiveBuffer.data() + size, mReceiveBuffer.capacity() - size,
+                [this](const error_code& ec, size_t br){
+                    mReading = false;
                     if (ec) {
                         std::cerr << ec.message() << std::endl;
-                        mSocket.close();
-                        mImpl.close();
+                        close();
                         return;
                     }
-                    read(bytes_read + br);
+                    mReceiveBuffer.resize(mReceiveBuffer.size() + br);
+                    read();
                 });
     }
+
+    void processRequests() {
+        size_t offset = 0;
+        auto bytesRead = mReceiveBuffer.size();
+        // the size gets checked as soon as it is there, reserveFrame relies on it
+        while (bytesRead - offset >= sizeof(size_t)) {
+            auto request = mReceiveBuffer.data() + offset;
+            auto reqSize = impl::frameSize(request);
+            if (!impl::validFrameSize(reqSize, impl::REQUEST_HEADER_SIZE)) {
+                std::cerr << "Client sent a frame of invalid size " << reqSize << std::endl;
+                close();
+                return;
+            }
+            if (mPending >= mMaxPending || bytesRead - offset < reqSize) {
+                break;
+            }
+            auto id = impl::frameId(request);
+            auto cmd = *reinterpret_cast<const Command*>(request + impl::RESPONSE_HEADER_SIZE);
+            auto version = *reinterpret_cast<const uint32_t*>(request + impl::RESPONSE_HEADER_SIZE + sizeof(Command));
+            if (version != impl::WIRE_VERSION) {
+                std::cerr << "Client uses wire version " << version << ", expected " << impl::WIRE_VERSION << std::endl;
+                close();
+                return;
+            }
+            if (!impl::RequestCheck(reqSize).valid(cmd)) {
+                std::cerr << "Client sent an invalid request for command " << int(cmd) << std::endl;
+                close();
+                return;
+            }
+            SWITCH_CASE(Command, cmd, COMMANDS, (id, request, request + reqSize))
+            if (mClosed) {
+                return;
+            }
+            offset += reqSize;
+        }
+        mReceiveBuffer.consume(offset);
+        impl::reserveFrame(mReceiveBuffer);
+    }
+
+    /**
+     * Closes the stream - the implementation gets closed as soon as there are
+     * no outstanding operations left.
+     */
+    void close() {
+        if (!mClosed) {
+            mClosed = true;
+            error_code ec;
+            mStream.close(ec);
+        }
+        if (mReading || mSending || mPending != 0) {
+            return;
+        }
+        mImpl.close();
+    }
 };
 
 } // namespace server
@@ -0,0 +1,325 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <crossbow/Serializer.hpp>
+#include <crossbow/string.hpp>
+
+namespace tpcc {
+
+/**
+ * A byte buffer that grows on demand but never shrinks.
+ *
+ * Connections keep their buffers for their whole lifetime, so once they
+ * reached the size of the largest frame no allocations happen anymore.
+ */
+class Buffer {
+    std::unique_ptr<uint8_t[]> mData;
+    size_t mCapacity;
+    size_t mSize = 0;
+public:
+    explicit Buffer(size_t capacity = 1024)
+        : mData(new uint8_t[capacity])
+        , mCapacity(capacity)
+    {}
+
+    uint8_t* data() { return mData.get(); }
+    const uint8_t* data() const { return mData.get(); }
+    size_t size() const { return mSize; }
+    size_t capacity() const { return mCapacity; }
+    bool empty() const { return mSize == 0; }
+
+    /**
+     * Makes sure the buffer can hold at least capacity bytes without
+     * reallocating, the content is preserved.
+     */
+    void reserve(size_t capacity) {
+        if (capacity <= mCapacity) {
+            return;
+        }
+        auto newCapacity = std::max(capacity, 2 * mCapacity);
+        std::unique_ptr<uint8_t[]> newData(new uint8_t[newCapacity]);
+        memcpy(newData.get(), mData.get(), mSize);
+        mData.swap(newData);
+        mCapacity = newCapacity;
+    }
+
+    /**
+     * Appends n uninitialized bytes and returns a pointer to them
+     */
+    uint8_t* grow(size_t n) {
+        reserve(mSize + n);
+        auto res = mData.get() + mSize;
+        mSize += n;
+        return res;
+    }
+
+    void resize(size_t size) {
+        reserve(size);
+        mSize = size;
+    }
+
+    void clear() {
+        mSize = 0;
+    }
+
+    /**
+     * Removes the first n bytes
+     */
+    void consume(size_t n) {
+        mSize -= n;
+        memmove(mData.get(), mData.get() + n, mSize);
+    }
+};
+
+namespace impl {
+
+template<class T, class Enable = void>
+struct has_serializable : std::false_type {};
+
+template<class T>
+struct has_serializable<T, typename std::enable_if<
+        std::is_same<typename T::is_serializable, crossbow::is_serializable>::value>::type> : std::true_type {};
+
+template<class T, class Enable = void>
+struct WirePolicy;
+
+// Types which provide their own operator&
+template<class T>
+struct WirePolicy<T, typename std::enable_if<has_serializable<T>::value>::type> {
+    template<class Writer>
+    static void write(Writer& w, const T& v) {
+        const_cast<T&>(v) & w;
+    }
+
+    template<class Reader>
+    static void read(Reader& r, T& v) {
+        v & r;
+    }
+};
+
+// Everything else that can be copied bytewise (numbers, enums, plain structs)
+template<class T>
+struct WirePolicy<T, typename std::enable_if<!has_serializable<T>::value && std::is_trivially_copyable<T>::value>::type> {
+    template<class Writer>
+    static void write(Writer& w, const T& v) {
+        w.write(&v, sizeof(T));
+    }
+
+    template<class Reader>
+    static void read(Reader& r, T& v) {
+        r.read(&v, sizeof(T));
+    }
+};
+
+template<>
+struct WirePolicy<crossbow::string> {
+    template<class Writer>
+    static void write(Writer& w, const crossbow::string& v) {
+        auto size = uint32_t(v.size());
+        w.write(&size, sizeof(size));
+        w.write(v.data(), size);
+    }
+
+    template<class Reader>
+    static void read(Reader& r, crossbow::string& v) {
+        uint32_t size = 0;
+        r.read(&size, sizeof(size));
+        if (size > r.remaining()) {
+            r.fail();
+            return;
+        }
+        v.assign(reinterpret_cast<const char*>(r.skip(size)), size);
+    }
+};
+
+template<class T>
+struct WirePolicy<std::vector<T>> {
+    template<class Writer>
+    static void write(Writer& w, const std::vector<T>& v) {
+        auto size = uint32_t(v.size());
+        w.write(&size, sizeof(size));
+        for (const auto& e : v) {
+            w & e;
+        }
+    }
+
+    template<class Reader>
+    static void read(Reader& r, std::vector<T>& v) {
+        uint32_t size = 0;
+        r.read(&size, sizeof(size));
+        // every element takes at least one byte, so this bounds the allocation
+        // by the size of the frame
+        if (size > r.remaining()) {
+            r.fail();
+            return;
+        }
+        v.resize(size);
+        for (auto& e : v) {
+            r & e;
+            if (!r.ok()) {
+                return;
+            }
+        }
+    }
+};
+
+template<class A, class B>
+struct WirePolicy<std::pair<A, B>> {
+    template<class Writer>
+    static void write(Writer& w, const std::pair<A, B>& v) {
+        w & v.first;
+        w & v.second;
+    }
+
+    template<class Reader>
+    static void read(Reader& r, std::pair<A, B>& v) {
+        r & v.first;
+        r & v.second;
+    }
+};
+
+template<size_t I, size_t N>
+struct TupleWire {
+    template<class Archiver, class Tuple>
+    static void exec(Archiver& ar, Tuple& t) {
+        ar & std::get<I>(t);
+        TupleWire<I + 1, N>::exec(ar, t);
+    }
+};
+
+template<size_t N>
+struct TupleWire<N, N> {
+    template<class Archiver, class Tuple>
+    static void exec(Archiver&, Tuple&) {}
+};
+
+template<class... T>
+struct WirePolicy<std::tuple<T...>> {
+    template<class Writer>
+    static void write(Writer& w, const std::tuple<T...>& v) {
+        TupleWire<0, sizeof...(T)>::exec(w, v);
+    }
+
+    template<class Reader>
+    static void read(Reader& r, std::tuple<T...>& v) {
+        TupleWire<0, sizeof...(T)>::exec(r, v);
+    }
+};
+
+} // namespace impl
+
+/**
+ * Serializes directly into a Buffer, growing it when needed - so unlike with
+ * crossbow::sizer/serializer the data only has to be traversed once.
+ */
+class BufferWriter {
+    Buffer& mBuffer;
+public:
+    BufferWriter(Buffer& buffer)
+        : mBuffer(buffer)
+    {}
+
+    template<class T>
+    BufferWriter& operator&(const T& v) {
+        impl::WirePolicy<T>::write(*this, v);
+        return *this;
+    }
+
+    void write(const void* data, size_t size) {
+        memcpy(mBuffer.grow(size), data, size);
+    }
+};
+
+/**
+ * Reads what a BufferWriter wrote from the range [pos, end).
+ *
+ * The data comes from the peer, so nothing is read past end: a read that does
+ * not fit marks the reader as failed and every read after it yields zeroes.
+ */
+class BufferReader {
+    const uint8_t* mPos;
+    const uint8_t* mEnd;
+    bool mFailed = false;
+public:
+    BufferReader(const uint8_t* pos, const uint8_t* end)
+        : mPos(pos)
+        , mEnd(end)
+    {}
+
+    template<class T>
+    BufferReader& operator&(T& v) {
+        impl::WirePolicy<T>::read(*this, v);
+        return *this;
+    }
+
+    void read(void* data, size_t size) {
+        if (size > remaining()) {
+            fail();
+            memset(data, 0, size);
+            return;
+        }
+        memcpy(data, mPos, size);
+        mPos += size;
+    }
+
+    const uint8_t* skip(size_t size) {
+        if (size > remaining()) {
+            fail();
+            return mPos;
+        }
+        auto res = mPos;
+        mPos += size;
+        return res;
+    }
+
+    const uint8_t* pos() const {
+        return mPos;
+    }
+
+    size_t remaining() const {
+        return size_t(mEnd - mPos);
+    }
+
+    /**
+     * Marks the input as malformed, nothing gets read anymore
+     */
+    void fail() {
+        mFailed = true;
+        mPos = mEnd;
+    }
+
+    bool ok() const {
+        return !mFailed;
+    }
+};
+
+} // namespace tpcc
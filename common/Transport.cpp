@@ -0,0 +1,378 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "Transport.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <crossbow/logger.hpp>
+
+namespace tpcc {
+
+Transport transportFromString(const std::string& name) {
+    if (name == "tcp") {
+        return Transport::TCP;
+    } else if (name == "unix") {
+        return Transport::UNIX;
+    } else if (name == "shm") {
+        return Transport::SHM;
+    }
+    throw std::invalid_argument("Unknown transport " + name);
+}
+
+std::string localPath(const std::string& host, const std::string& port) {
+    if (!host.empty()) {
+        return host;
+    }
+    return "/tmp/tpcc_" + port + ".sock";
+}
+
+Stream::~Stream() = default;
+
+namespace impl {
+
+constexpr size_t ShmRing::CAPACITY;
+
+size_t ShmRing::push(const uint8_t* src, size_t size) {
+    auto h = head.load(std::memory_order_relaxed);
+    auto t = tail.load();
+    auto n = std::min(size, size_t(CAPACITY - (h - t)));
+    auto pos = h % CAPACITY;
+    auto first = std::min(n, CAPACITY - pos);
+    memcpy(data + pos, src, first);
+    memcpy(data, src + first, n - first);
+    // has to be sequentially consistent with the load of readerWaiting
+    head.store(h + n);
+    return n;
+}
+
+size_t ShmRing::pop(uint8_t* dest, size_t size) {
+    auto t = tail.load(std::memory_order_relaxed);
+    auto h = head.load();
+    auto n = std::min(size, size_t(h - t));
+    auto pos = t % CAPACITY;
+    auto first = std::min(n, CAPACITY - pos);
+    memcpy(dest, data + pos, first);
+    memcpy(dest + first, data, n - first);
+    tail.store(t + n);
+    return n;
+}
+
+namespace {
+
+constexpr size_t SEGMENT_SIZE = 2 * sizeof(ShmRing);
+
+void* mapSegment(int fd) {
+    auto segment = mmap(nullptr, SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (segment == MAP_FAILED) {
+        throw std::system_error(errno, std::system_category(), "mmap");
+    }
+    return segment;
+}
+
+} // anonymous namespace
+
+} // namespace impl
+
+ShmStream::ShmStream(boost::asio::local::stream_protocol::socket doorbell, void* segment, size_t segmentSize,
+        bool isServer)
+    : mDoorbell(std::move(doorbell))
+    , mSegment(segment)
+    , mSegmentSize(segmentSize)
+    , mAlive(new char(0))
+{
+    // the first ring carries requests, the second one responses
+    auto rings = reinterpret_cast<impl::ShmRing*>(segment);
+    mIn = isServer ? rings : rings + 1;
+    mOut = isServer ? rings + 1 : rings;
+    // waking up the peer must never block
+    mDoorbell.non_blocking(true);
+}
+
+ShmStream::~ShmStream() {
+    munmap(mSegment, mSegmentSize);
+}
+
+std::unique_ptr<Stream> ShmStream::connect(boost::asio::io_service& service, const std::string& path) {
+    static std::atomic<unsigned> counter(0);
+    boost::asio::local::stream_protocol::socket socket(service);
+    socket.connect(boost::asio::local::stream_protocol::endpoint(path));
+
+    auto name = "/tpcc_" + std::to_string(getpid()) + "_" + std::to_string(counter++);
+    auto fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        throw std::system_error(errno, std::system_category(), "shm_open");
+    }
+    if (ftruncate(fd, impl::SEGMENT_SIZE) != 0) {
+        auto err = errno;
+        ::close(fd);
+        shm_unlink(name.c_str());
+        throw std::system_error(err, std::system_category(), "ftruncate");
+    }
+    void* segment;
+    try {
+        segment = impl::mapSegment(fd);
+    } catch (...) {
+        shm_unlink(name.c_str());
+        throw;
+    }
+    auto rings = reinterpret_cast<impl::ShmRing*>(segment);
+    for (int i = 0; i < 2; ++i) {
+        auto ring = new (rings + i) impl::ShmRing;
+        ring->head = 0;
+        ring->tail = 0;
+        ring->readerWaiting = false;
+        ring->writerWaiting = false;
+    }
+    std::unique_ptr<Stream> stream(new ShmStream(std::move(socket), segment, impl::SEGMENT_SIZE, false));
+
+    // the server unlinks the segment as soon as it mapped it
+    auto& doorbell = static_cast<ShmStream&>(*stream).mDoorbell;
+    doorbell.non_blocking(false);
+    auto size = uint32_t(name.size());
+    boost::asio::write(doorbell, boost::asio::buffer(&size, sizeof(size)));
+    boost::asio::write(doorbell, boost::asio::buffer(name));
+    uint8_t ack;
+    boost::asio::read(doorbell, boost::asio::buffer(&ack, sizeof(ack)));
+    doorbell.non_blocking(true);
+    return stream;
+}
+
+namespace {
+
+struct ShmHandshake {
+    std::unique_ptr<UnixStream> socket;
+    std::function<void(std::unique_ptr<Stream>)> callback;
+    uint32_t size;
+    std::string name;
+};
+
+} // anonymous namespace
+
+void ShmStream::accept(std::unique_ptr<UnixStream> socket, std::function<void(std::unique_ptr<Stream>)> callback) {
+    auto handshake = std::make_shared<ShmHandshake>();
+    handshake->socket = std::move(socket);
+    handshake->callback = std::move(callback);
+    auto& s = handshake->socket->socket();
+    boost::asio::async_read(s, boost::asio::buffer(&handshake->size, sizeof(handshake->size)),
+            [handshake](const error_code& ec, size_t) {
+        if (ec || handshake->size > 255) {
+            LOG_ERROR("Shared memory handshake failed");
+            handshake->callback(nullptr);
+            return;
+        }
+        handshake->name.resize(handshake->size);
+        auto& s = handshake->socket->socket();
+        boost::asio::async_read(s, boost::asio::buffer(&handshake->name[0], handshake->size),
+                [handshake](const error_code& ec, size_t) {
+            if (ec) {
+                LOG_ERROR("Shared memory handshake failed: %1%", ec.message());
+                handshake->callback(nullptr);
+                return;
+            }
+            auto fd = shm_open(handshake->name.c_str(), O_RDWR, 0600);
+            if (fd < 0) {
+                LOG_ERROR("Could not open shared memory segment %1%", handshake->name);
+                handshake->callback(nullptr);
+                return;
+            }
+            shm_unlink(handshake->name.c_str());
+            void* segment;
+            try {
+                segment = impl::mapSegment(fd);
+            } catch (std::system_error& e) {
+                LOG_ERROR(e.what());
+                handshake->callback(nullptr);
+                return;
+            }
+            auto& s = handshake->socket->socket();
+            uint8_t ack = 1;
+            error_code err;
+            boost::asio::write(s, boost::asio::buffer(&ack, sizeof(ack)), err);
+            if (err) {
+                munmap(segment, impl::SEGMENT_SIZE);
+                handshake->callback(nullptr);
+                return;
+            }
+            handshake->callback(std::unique_ptr<Stream>(
+                        new ShmStream(std::move(s), segment, impl::SEGMENT_SIZE, true)));
+        });
+    });
+}
+
+void ShmStream::asyncReadSome(uint8_t* data, size_t size, Handler handler) {
+    mReadData = data;
+    mReadSize = size;
+    mReadHandler = std::move(handler);
+    waitRead();
+}
+
+void ShmStream::asyncWrite(const uint8_t* data, size_t size, Handler handler) {
+    mWriteData = data;
+    mWriteSize = size;
+    mWritten = 0;
+    mWriteHandler = std::move(handler);
+    waitWrite();
+}
+
+void ShmStream::close(error_code& ec) {
+    mDoorbell.shutdown(boost::asio::local::stream_protocol::socket::shutdown_both, ec);
+    mDoorbell.close(ec);
+}
+
+bool ShmStream::tryRead() {
+    auto n = mIn->pop(mReadData, mReadSize);
+    if (n == 0) {
+        return false;
+    }
+    if (mIn->writerWaiting.exchange(false)) {
+        ring();
+    }
+    complete(mReadHandler, error_code(), n);
+    return true;
+}
+
+bool ShmStream::tryWrite() {
+    auto n = mOut->push(mWriteData + mWritten, mWriteSize - mWritten);
+    mWritten += n;
+    if (n != 0 && mOut->readerWaiting.exchange(false)) {
+        ring();
+    }
+    if (mWritten < mWriteSize) {
+        return false;
+    }
+    complete(mWriteHandler, error_code(), mWriteSize);
+    return true;
+}
+
+void ShmStream::waitRead() {
+    if (tryRead()) {
+        return;
+    }
+    // announce that we are waiting and check again, otherwise a write between
+    // the first check and the announcement would not wake us up
+    mIn->readerWaiting = true;
+    if (tryRead()) {
+        return;
+    }
+    armBell();
+}
+
+void ShmStream::waitWrite() {
+    if (tryWrite()) {
+        return;
+    }
+    mOut->writerWaiting = true;
+    if (tryWrite()) {
+        return;
+    }
+    armBell();
+}
+
+void ShmStream::ring() {
+    uint8_t bell = 0;
+    error_code ec;
+    // if the socket buffer is full the peer has enough wake ups pending anyway
+    mDoorbell.write_some(boost::asio::buffer(&bell, sizeof(bell)), ec);
+}
+
+void ShmStream::armBell() {
+    if (mBellArmed) {
+        return;
+    }
+    mBellArmed = true;
+    std::weak_ptr<char> alive = mAlive;
+    mDoorbell.async_read_some(boost::asio::buffer(mBell), [this, alive](const error_code& ec, size_t) {
+        if (alive.expired()) {
+            return;
+        }
+        onBell(ec);
+    });
+}
+
+void ShmStream::onBell(const error_code& ec) {
+    mBellArmed = false;
+    // data the peer wrote before it closed the connection still gets delivered
+    if (mReadHandler && !tryRead()) {
+        if (ec) {
+            complete(mReadHandler, ec, 0);
+        } else {
+            waitRead();
+        }
+    }
+    if (mWriteHandler && !tryWrite()) {
+        if (ec) {
+            complete(mWriteHandler, ec, mWritten);
+        } else {
+            waitWrite();
+        }
+    }
+}
+
+void ShmStream::complete(Handler& handler, const error_code& ec, size_t size) {
+    Handler h;
+    h.swap(handler);
+    service().post([h, ec, size]() {
+        h(ec, size);
+    });
+}
+
+std::unique_ptr<Stream> connect(boost::asio::io_service& service, Transport transport,
+        const std::string& host, const std::string& port) {
+    switch (transport) {
+    case Transport::TCP:
+        {
+            using boost::asio::ip::tcp;
+            tcp::resolver resolver(service);
+            tcp::resolver::iterator iter;
+            if (host.empty()) {
+                iter = resolver.resolve(tcp::resolver::query(port));
+            } else {
+                iter = resolver.resolve(tcp::resolver::query(host, port));
+            }
+            std::unique_ptr<TcpStream> stream(new TcpStream(service));
+            boost::asio::connect(stream->socket(), iter);
+            return std::move(stream);
+        }
+    case Transport::UNIX:
+        {
+            std::unique_ptr<UnixStream> stream(new UnixStream(service));
+            stream->socket().connect(boost::asio::local::stream_protocol::endpoint(localPath(host, port)));
+            return std::move(stream);
+        }
+    case Transport::SHM:
+        return ShmStream::connect(service, localPath(host, port));
+    }
+    throw std::invalid_argument("Unknown transport");
+}
+
+} // namespace tpcc
@@ -0,0 +1,232 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <boost/asio.hpp>
+#include <boost/system/error_code.hpp>
+
+namespace tpcc {
+
+/**
+ * How client and server talk to each other.
+ *
+ * TCP works everywhere, UNIX and SHM only between processes on the same host:
+ * UNIX uses an AF_UNIX stream socket, SHM moves the data through a pair of
+ * single-producer/single-consumer rings in shared memory and only falls back
+ * to a unix socket to wake up a peer that ran out of work.
+ */
+enum class Transport {
+    TCP,
+    UNIX,
+    SHM
+};
+
+/**
+ * Parses "tcp", "unix" or "shm" - throws std::invalid_argument otherwise.
+ */
+Transport transportFromString(const std::string& name);
+
+/**
+ * The socket path the local transports use: the host if one was given, a
+ * path derived from the port otherwise.
+ */
+std::string localPath(const std::string& host, const std::string& port);
+
+/**
+ * A connected, bidirectional byte stream.
+ *
+ * This is what the protocol in Protocol.hpp runs on. Completion handlers are
+ * never invoked from within the initiating call but always through the
+ * io_service the stream is bound to. There must be at most one read and one
+ * write outstanding at any time.
+ */
+class Stream {
+public:
+    using error_code = boost::system::error_code;
+    using Handler = std::function<void(const error_code&, size_t)>;
+
+    virtual ~Stream();
+
+    virtual boost::asio::io_service& service() = 0;
+
+    /**
+     * Reads at least one and at most size bytes
+     */
+    virtual void asyncReadSome(uint8_t* data, size_t size, Handler handler) = 0;
+
+    /**
+     * Writes all size bytes
+     */
+    virtual void asyncWrite(const uint8_t* data, size_t size, Handler handler) = 0;
+
+    /**
+     * Shuts down both directions and closes the stream, outstanding operations
+     * complete with an error.
+     */
+    virtual void close(error_code& ec) = 0;
+};
+
+/**
+ * A stream on top of an asio socket (TCP or AF_UNIX)
+ */
+template<class Protocol>
+class SocketStream : public Stream {
+    typename Protocol::socket mSocket;
+public:
+    SocketStream(boost::asio::io_service& service)
+        : mSocket(service)
+    {}
+
+    typename Protocol::socket& socket() {
+        return mSocket;
+    }
+
+    boost::asio::io_service& service() override {
+        return mSocket.get_io_service();
+    }
+
+    void asyncReadSome(uint8_t* data, size_t size, Handler handler) override {
+        mSocket.async_read_some(boost::asio::buffer(data, size), std::move(handler));
+    }
+
+    void asyncWrite(const uint8_t* data, size_t size, Handler handler) override {
+        boost::asio::async_write(mSocket, boost::asio::buffer(data, size), std::move(handler));
+    }
+
+    void close(error_code& ec) override {
+        mSocket.shutdown(Protocol::socket::shutdown_both, ec);
+        mSocket.close(ec);
+    }
+};
+
+using TcpStream = SocketStream<boost::asio::ip::tcp>;
+using UnixStream = SocketStream<boost::asio::local::stream_protocol>;
+
+namespace impl {
+
+/**
+ * One direction of a shared memory connection: a lock-free ring with exactly
+ * one producer and one consumer. head and tail count bytes ever written and
+ * read, so they never wrap and head - tail is the fill level.
+ */
+struct ShmRing {
+    static constexpr size_t CAPACITY = 1 << 20;
+
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+    // set by the consumer before it goes to sleep on an empty ring
+    alignas(64) std::atomic<bool> readerWaiting;
+    // set by the producer before it goes to sleep on a full ring
+    std::atomic<bool> writerWaiting;
+    alignas(64) uint8_t data[CAPACITY];
+
+    /**
+     * Copies as many bytes as fit into the ring and returns their number
+     */
+    size_t push(const uint8_t* src, size_t size);
+
+    /**
+     * Copies at most size bytes out of the ring and returns their number
+     */
+    size_t pop(uint8_t* dest, size_t size);
+};
+
+} // namespace impl
+
+/**
+ * A stream over two shared memory rings.
+ *
+ * The unix socket the connection was set up with stays open as a doorbell:
+ * a side which finds its ring empty (or full) announces that it is waiting
+ * and then blocks in a read on the socket, the peer writes a single byte
+ * after it made progress. As long as both sides are busy no system call is
+ * made at all.
+ */
+class ShmStream : public Stream {
+    boost::asio::local::stream_protocol::socket mDoorbell;
+    void* mSegment;
+    size_t mSegmentSize;
+    impl::ShmRing* mIn;
+    impl::ShmRing* mOut;
+    uint8_t* mReadData = nullptr;
+    size_t mReadSize = 0;
+    Handler mReadHandler;
+    const uint8_t* mWriteData = nullptr;
+    size_t mWriteSize = 0;
+    size_t mWritten = 0;
+    Handler mWriteHandler;
+    bool mBellArmed = false;
+    uint8_t mBell[64];
+    // handlers of the doorbell may run after the stream got destroyed
+    std::shared_ptr<char> mAlive;
+
+    ShmStream(boost::asio::local::stream_protocol::socket doorbell, void* segment, size_t segmentSize, bool isServer);
+public:
+    ~ShmStream();
+
+    /**
+     * Creates a shared memory segment and hands it to the server listening
+     * on path - blocks until the server has the connection.
+     */
+    static std::unique_ptr<Stream> connect(boost::asio::io_service& service, const std::string& path);
+
+    /**
+     * Receives the segment from a client which just connected to socket and
+     * calls callback with the stream (or nullptr on failure).
+     */
+    static void accept(std::unique_ptr<UnixStream> socket, std::function<void(std::unique_ptr<Stream>)> callback);
+
+    boost::asio::io_service& service() override {
+        return mDoorbell.get_io_service();
+    }
+
+    void asyncReadSome(uint8_t* data, size_t size, Handler handler) override;
+
+    void asyncWrite(const uint8_t* data, size_t size, Handler handler) override;
+
+    void close(error_code& ec) override;
+
+private:
+    bool tryRead();
+    bool tryWrite();
+    void waitRead();
+    void waitWrite();
+    void ring();
+    void armBell();
+    void onBell(const error_code& ec);
+    void complete(Handler& handler, const error_code& ec, size_t size);
+};
+
+/**
+ * Connects to a server - host is a host name for TCP and a socket path for the
+ * local transports.
+ */
+std::unique_ptr<Stream> connect(boost::asio::io_service& service, Transport transport,
+        const std::string& host, const std::string& port);
+
+} // namespace tpcc
@@ -0,0 +1,68 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "AdmissionControl.hpp"
+
+namespace tpcc {
+
+bool AdmissionControl::admit(boost::asio::io_service& service, std::function<void()> start) {
+    {
+        std::unique_lock<std::mutex> _(mMutex);
+        if (mMaxRunning != 0 && mRunning >= mMaxRunning) {
+            if (mMaxQueued != 0 && mQueue.size() >= mMaxQueued) {
+                return false;
+            }
+            mQueue.emplace_back(Waiter{&service, std::move(start)});
+            return true;
+        }
+        ++mRunning;
+    }
+    start();
+    return true;
+}
+
+void AdmissionControl::release() {
+    Waiter next;
+    {
+        std::unique_lock<std::mutex> _(mMutex);
+        if (mQueue.empty()) {
+            --mRunning;
+            return;
+        }
+        // the slot goes directly to the oldest waiter
+        next = std::move(mQueue.front());
+        mQueue.pop_front();
+    }
+    next.service->post(std::move(next.start));
+}
+
+size_t AdmissionControl::running() {
+    std::unique_lock<std::mutex> _(mMutex);
+    return mRunning;
+}
+
+size_t AdmissionControl::queued() {
+    std::unique_lock<std::mutex> _(mMutex);
+    return mQueue.size();
+}
+
+} // namespace tpcc
@@ -0,0 +1,76 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <boost/asio.hpp>
+
+namespace tpcc {
+
+/**
+ * Limits the number of transactions running in the whole server process.
+ *
+ * Transactions over the limit wait in a FIFO queue and get started (on the
+ * thread of their connection) as soon as a running one finishes. If the queue
+ * is bounded, transactions which do not fit anymore are rejected right away -
+ * this keeps the storage at its peak throughput instead of letting it thrash
+ * under more load than it can handle.
+ */
+class AdmissionControl {
+    struct Waiter {
+        boost::asio::io_service* service;
+        std::function<void()> start;
+    };
+    std::mutex mMutex;
+    size_t mMaxRunning;
+    size_t mMaxQueued;
+    size_t mRunning = 0;
+    std::deque<Waiter> mQueue;
+public:
+    /**
+     * A limit of 0 means unlimited
+     */
+    AdmissionControl(size_t maxRunning, size_t maxQueued)
+        : mMaxRunning(maxRunning)
+        , mMaxQueued(maxQueued)
+    {}
+
+    /**
+     * Calls start right away if the limit allows it, otherwise queues it to be
+     * posted to service later. Returns false if the transaction got rejected.
+     */
+    bool admit(boost::asio::io_service& service, std::function<void()> start);
+
+    /**
+     * Has to be called once for every admitted transaction when it finished
+     */
+    void release();
+
+    size_t running();
+
+    size_t queued();
+};
+
+} // namespace tpcc
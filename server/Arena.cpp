@@ -0,0 +1,99 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "Arena.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace tpcc {
+
+namespace {
+
+/**
+ * Chunks of the default size which are not used by any arena right now
+ */
+class ChunkCache {
+    static constexpr size_t MAX_CACHED = 16;
+    std::vector<void*> mChunks;
+public:
+    ~ChunkCache() {
+        for (auto chunk : mChunks) {
+            free(chunk);
+        }
+    }
+
+    void* get() {
+        if (mChunks.empty()) {
+            return nullptr;
+        }
+        auto chunk = mChunks.back();
+        mChunks.pop_back();
+        return chunk;
+    }
+
+    bool put(void* chunk) {
+        if (mChunks.size() >= MAX_CACHED) {
+            return false;
+        }
+        mChunks.push_back(chunk);
+        return true;
+    }
+};
+
+thread_local ChunkCache chunkCache;
+
+} // anonymous namespace
+
+constexpr size_t Arena::CHUNK_SIZE;
+
+Arena::~Arena() {
+    while (mChunks) {
+        auto chunk = mChunks;
+        mChunks = chunk->next;
+        if (chunk->size != CHUNK_SIZE || !chunkCache.put(chunk)) {
+            free(chunk);
+        }
+    }
+}
+
+void Arena::grow(size_t size) {
+    // whatever is left in the current chunk gets wasted, chunks are large
+    // compared to the temporaries of a transaction
+    auto chunkSize = std::max(CHUNK_SIZE, size + sizeof(Chunk));
+    void* memory = chunkSize == CHUNK_SIZE ? chunkCache.get() : nullptr;
+    if (memory == nullptr) {
+        memory = malloc(chunkSize);
+        if (memory == nullptr) {
+            throw std::bad_alloc();
+        }
+    }
+    auto chunk = static_cast<Chunk*>(memory);
+    chunk->next = mChunks;
+    chunk->size = chunkSize;
+    mChunks = chunk;
+    mPos = reinterpret_cast<char*>(chunk + 1);
+    mEnd = static_cast<char*>(memory) + chunkSize;
+}
+
+} // namespace tpcc
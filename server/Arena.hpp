@@ -0,0 +1,111 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tpcc {
+
+/**
+ * A bump allocator for the temporaries of one transaction.
+ *
+ * Memory is handed out from chunks which are only given back as a whole when
+ * the arena gets destroyed. The chunks are cached per thread, so after warm-up
+ * a transaction does not call malloc for its temporaries at all.
+ */
+class Arena {
+    struct Chunk {
+        Chunk* next;
+        size_t size;
+    };
+    Chunk* mChunks = nullptr;
+    char* mPos = nullptr;
+    char* mEnd = nullptr;
+public:
+    static constexpr size_t CHUNK_SIZE = 16 * 1024;
+
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena();
+
+    void* allocate(size_t size, size_t alignment) {
+        auto pos = alignUp(mPos, alignment);
+        if (pos == nullptr || pos + size > mEnd) {
+            grow(size + alignment);
+            pos = alignUp(mPos, alignment);
+        }
+        mPos = pos + size;
+        return pos;
+    }
+
+private:
+    static char* alignUp(char* ptr, size_t alignment) {
+        return reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(ptr) + alignment - 1) & ~(alignment - 1));
+    }
+
+    void grow(size_t size);
+};
+
+/**
+ * Standard allocator on top of an arena - deallocation is a no-op
+ */
+template<class T>
+class ArenaAllocator {
+    template<class U>
+    friend class ArenaAllocator;
+    Arena* mArena;
+public:
+    using value_type = T;
+
+    ArenaAllocator(Arena& arena)
+        : mArena(&arena)
+    {}
+
+    template<class U>
+    ArenaAllocator(const ArenaAllocator<U>& other)
+        : mArena(other.mArena)
+    {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(mArena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, size_t) {}
+
+    template<class U>
+    bool operator==(const ArenaAllocator<U>& other) const {
+        return mArena == other.mArena;
+    }
+
+    template<class U>
+    bool operator!=(const ArenaAllocator<U>& other) const {
+        return mArena != other.mArena;
+    }
+};
+
+template<class T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+} // namespace tpcc
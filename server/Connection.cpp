@@ -21,34 +21,139 @@
  *     Lucas Braun <braunl@inf.ethz.ch>
  */
 #include "Connection.hpp"
+#include "AdmissionControl.hpp"
+#include "Statistics.hpp"
+#include "RetryPolicy.hpp"
+#include "TableCatalog.hpp"
+#include "WarehouseAffinity.hpp"
+#include "DeliveryQueue.hpp"
+#include "ItemCache.hpp"
 #include "CreateSchema.hpp"
 #include "Populate.hpp"
+#include "ServicePool.hpp"
 #include "Transactions.hpp"
 
 #include <telldb/Transaction.hpp>
+#include <crossbow/logger.hpp>
+
+#include <boost/optional.hpp>
+
+#include <cassert>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <vector>
 
 using namespace boost::asio;
 
 namespace tpcc {
 
+namespace {
+
+/**
+ * State of a running benchmark transaction
+ */
+template<Command C>
+struct TransactionSlot {
+    using Result = typename Signature<C>::result;
+    typename Signature<C>::arguments args;
+    // the result mode of the connection when the request arrived
+    ResultMode resultMode;
+    Result result;
+    std::function<void(const Result&)> callback;
+    tell::store::TransactionType type;
+    Statistics::Clock::time_point start;
+    unsigned attempts;
+    boost::optional<tell::db::TransactionFiber<void>> fiber;
+    // waits for the backoff before a retry
+    boost::optional<boost::asio::steady_timer> timer;
+};
+
+/**
+ * Recycles the transaction slots of a connection, so after warm-up starting a
+ * transaction does not allocate anything on our side.
+ */
+template<Command C>
+class SlotPool {
+    // a deque never moves its elements
+    std::deque<TransactionSlot<C>> mSlots;
+    std::vector<TransactionSlot<C>*> mFree;
+public:
+    TransactionSlot<C>* acquire() {
+        if (mFree.empty()) {
+            mSlots.emplace_back();
+            return &mSlots.back();
+        }
+        auto slot = mFree.back();
+        mFree.pop_back();
+        return slot;
+    }
+
+    void release(TransactionSlot<C>* slot) {
+        mFree.push_back(slot);
+    }
+
+    bool idle() const {
+        return mFree.size() == mSlots.size();
+    }
+};
+
+} // anonymous namespace
+
 class CommandImpl {
     Connection* mConnection;
     server::Server<CommandImpl> mServer;
     boost::asio::io_service& mService;
+    ServicePool& mPool;
+    AdmissionControl& mAdmission;
+    Statistics& mStatistics;
+    const RetryPolicy& mRetryPolicy;
+    // nullptr if transactions run on the thread of the connection
+    WarehouseAffinity* mAffinity;
+    // nullptr if deliveries run while the client waits
+    DeliveryQueue* mDeliveries;
+    // nullptr if NewOrder reads the items from the storage
+    ItemCache* mItems;
     tell::db::ClientManager<void>& mClientManager;
-    std::unique_ptr<tell::db::TransactionFiber<void>> mFiber;
+    TableCatalog& mCatalog;
+    // transactions which are currently running on this connection
+    uint64_t mNextFiber = 0;
+    std::unordered_map<uint64_t, std::unique_ptr<tell::db::TransactionFiber<void>>> mFibers;
+    SlotPool<Command::NEW_ORDER> mNewOrderSlots;
+    SlotPool<Command::PAYMENT> mPaymentSlots;
+    SlotPool<Command::ORDER_STATUS> mOrderStatusSlots;
+    SlotPool<Command::DELIVERY> mDeliverySlots;
+    SlotPool<Command::STOCK_LEVEL> mStockLevelSlots;
     Transactions mTransactions;
+    // only accessed on the thread of the connection, running transactions
+    // use the copy in their slot
+    ResultMode mResultMode = ResultMode::FULL;
 public:
     CommandImpl(Connection* connection,
-            boost::asio::ip::tcp::socket& socket,
+            Stream& stream,
             boost::asio::io_service& service,
+            ServicePool& pool,
+            AdmissionControl& admission,
+            Statistics& statistics,
+            const RetryPolicy& retryPolicy,
+            WarehouseAffinity* affinity,
+            DeliveryQueue* deliveries,
+            ItemCache* items,
             tell::db::ClientManager<void>& clientManager,
-            int16_t numWarehouses)
+            TableCatalog& catalog)
         : mConnection(connection)
-        , mServer(*this, socket)
+        , mServer(*this, stream)
         , mService(service)
+        , mPool(pool)
+        , mAdmission(admission)
+        , mStatistics(statistics)
+        , mRetryPolicy(retryPolicy)
+        , mAffinity(affinity)
+        , mDeliveries(deliveries)
+        , mItems(items)
         , mClientManager(clientManager)
-        , mTransactions(numWarehouses)
+        , mCatalog(catalog)
+        , mTransactions(catalog, statistics, items)
     {}
 
     void run() {
@@ -56,51 +161,76 @@ public:
     }
 
     void close() {
+        // the server only closes when all requests got answered
+        assert(mFibers.empty());
+        assert(mNewOrderSlots.idle() && mPaymentSlots.idle() && mOrderStatusSlots.idle()
+                && mDeliverySlots.idle() && mStockLevelSlots.idle());
         delete mConnection;
     }
 
     template<Command C, class Callback>
     typename std::enable_if<C == Command::EXIT, void>::type
     execute(const Callback callback) {
-        mServer.quit();
+        mServer.quit([this]() {
+            mPool.stop();
+        });
         callback();
     }
 
+    template<Command C, class Callback>
+    typename std::enable_if<C == Command::STATS, void>::type
+    execute(const Callback callback) {
+        callback(mStatistics.snapshot(mAdmission.running(), mAdmission.queued()));
+    }
+
+    template<Command C, class Callback>
+    typename std::enable_if<C == Command::SET_RESULT_MODE, void>::type
+    execute(ResultMode mode, const Callback& callback) {
+        mResultMode = mode;
+        callback(mode);
+    }
+
     template<Command C, class Callback>
     typename std::enable_if<C == Command::CREATE_SCHEMA, void>::type
     execute(std::tuple<int16_t, bool> args, const Callback& callback) {
         bool ch = std::get<1>(args);
-        auto transaction = [this, ch, callback](tell::db::Transaction& tx){
+        auto key = ++mNextFiber;
+        auto transaction = [this, key, ch, callback](tell::db::Transaction& tx){
             bool success;
             crossbow::string msg;
             try {
-                createSchema(tx, ch);
+                createSchema(tx, ch, mCatalog.layout());
                 tx.commit();
+                // the tables got new ids
+                mCatalog.invalidate();
+                if (mItems) {
+                    mItems->invalidate();
+                }
                 success = true;
             } catch (std::exception& ex) {
                 tx.rollback();
                 success = false;
                 msg = ex.what();
             }
-            mService.post([this, callback, success, msg](){
-                mFiber->wait();
-                mFiber.reset(nullptr);
+            mService.post([this, key, callback, success, msg](){
+                finishFiber(key);
                 callback(std::make_tuple(success, msg));
             });
         };
-        mFiber.reset(new tell::db::TransactionFiber<void>(mClientManager.startTransaction(transaction)));
+        startFiber(key, transaction);
     }
 
     template<Command C, class Callback>
     typename std::enable_if<C == Command::POPULATE_WAREHOUSE, void>::type
     execute(std::tuple<int16_t, bool> args, const Callback& callback) {
-        auto transaction = [this, args, callback](tell::db::Transaction& tx) {
+        auto key = ++mNextFiber;
+        auto transaction = [this, key, args, callback](tell::db::Transaction& tx) {
             bool success;
             crossbow::string msg;
             try {
-                auto counter = tx.getCounter("history_counter");
-                Populator populator;
-                populator.populateWarehouse(tx, counter, std::get<0>(args), std::get<1>(args));
+                HistoryIds historyIds;
+                Populator populator(mCatalog.layout());
+                populator.populateWarehouse(tx, historyIds, std::get<0>(args), std::get<1>(args));
                 tx.commit();
                 success = true;
             } catch (std::exception& ex) {
@@ -108,19 +238,19 @@ public:
                 success = false;
                 msg = ex.what();
             }
-            mService.post([this, success, msg, callback](){
-                mFiber->wait();
-                mFiber.reset(nullptr);
+            mService.post([this, key, success, msg, callback](){
+                finishFiber(key);
                 callback(std::make_pair(success, msg));
             });
         };
-        mFiber.reset(new tell::db::TransactionFiber<void>(mClientManager.startTransaction(transaction)));
+        startFiber(key, transaction);
     }
 
     template<Command C, class Callback>
     typename std::enable_if<C == Command::POPULATE_DIM_TABLES, void>::type
     execute(bool args, const Callback& callback) {
-        auto transaction = [this, args, callback](tell::db::Transaction& tx) {
+        auto key = ++mNextFiber;
+        auto transaction = [this, key, args, callback](tell::db::Transaction& tx) {
             bool success;
             crossbow::string msg;
             try {
@@ -133,96 +263,253 @@ public:
                 success = false;
                 msg = ex.what();
             }
-            mService.post([this, success, msg, callback](){
-                mFiber->wait();
-                mFiber.reset(nullptr);
+            mService.post([this, key, success, msg, callback](){
+                finishFiber(key);
+                // blocks this thread, but population is not measured anyway
+                if (success && mItems && !mItems->load()) {
+                    LOG_WARN("Could not load the item cache, items are read from the storage");
+                }
                 callback(std::make_pair(success, msg));
             });
         };
-        mFiber.reset(new tell::db::TransactionFiber<void>(mClientManager.startTransaction(transaction)));
+        startFiber(key, transaction);
     }
 
     template<Command C, class Callback>
     typename std::enable_if<C == Command::NEW_ORDER, void>::type
     execute(const typename Signature<C>::arguments& args, const Callback& callback) {
-        auto transaction = [this, args, callback](tell::db::Transaction& tx) {
-            typename Signature<C>::result res = mTransactions.newOrderTransaction(tx, args);
-            mService.post([this, res, callback]() {
-                mFiber->wait();
-                mFiber.reset(nullptr);
-                callback(res);
-            });
-        };
-        mFiber.reset(new tell::db::TransactionFiber<void>(mClientManager.startTransaction(transaction)));
+        runTransaction<C>(args, callback);
     }
 
     template<Command C, class Callback>
     typename std::enable_if<C == Command::PAYMENT, void>::type
     execute(const typename Signature<C>::arguments& args, const Callback& callback) {
-        auto transaction = [this, args, callback](tell::db::Transaction& tx) {
-            typename Signature<C>::result res = mTransactions.payment(tx, args);
-            mService.post([this, res, callback]() {
-                mFiber->wait();
-                mFiber.reset(nullptr);
-                callback(res);
-            });
-        };
-        mFiber.reset(new tell::db::TransactionFiber<void>(mClientManager.startTransaction(transaction)));
+        runTransaction<C>(args, callback);
     }
 
     template<Command C, class Callback>
     typename std::enable_if<C == Command::ORDER_STATUS, void>::type
     execute(const typename Signature<C>::arguments& args, const Callback& callback) {
-        auto transaction = [this, args, callback](tell::db::Transaction& tx) {
-            typename Signature<C>::result res = mTransactions.orderStatus(tx, args);
-            mService.post([this, res, callback]() {
-                mFiber->wait();
-                mFiber.reset(nullptr);
-                callback(res);
-            });
-        };
-        mFiber.reset(new tell::db::TransactionFiber<void>(mClientManager.startTransaction(transaction)));
+        runTransaction<C>(args, callback);
     }
 
     template<Command C, class Callback>
     typename std::enable_if<C == Command::DELIVERY, void>::type
     execute(const typename Signature<C>::arguments& args, const Callback& callback) {
-        auto transaction = [this, args, callback](tell::db::Transaction& tx) {
-            typename Signature<C>::result res = mTransactions.delivery(tx, args);
-            mService.post([this, res, callback]() {
-                mFiber->wait();
-                mFiber.reset(nullptr);
-                callback(res);
-            });
-        };
-        mFiber.reset(new tell::db::TransactionFiber<void>(mClientManager.startTransaction(transaction)));
+        if (!mDeliveries) {
+            runTransaction<C>(args, callback);
+            return;
+        }
+        // deferred: the client only learns whether the delivery got queued,
+        // the queue records the statistics once it got executed
+        DeliveryResult res;
+        res.success = mDeliveries->push(args);
+        res.low_stock = 0;
+        if (!res.success) {
+            res.error = SERVER_BUSY;
+            res.abortReason = AbortReason::BUSY;
+            mStatistics.record(C, res, Statistics::Clock::now());
+        }
+        callback(res);
     }
 
     template<Command C, class Callback>
     typename std::enable_if<C == Command::STOCK_LEVEL, void>::type
     execute(const typename Signature<C>::arguments& args, const Callback& callback) {
-        auto transaction = [this, args, callback](tell::db::Transaction& tx) {
-            typename Signature<C>::result res = mTransactions.stockLevel(tx, args);
-            mService.post([this, res, callback]() {
-                mFiber->wait();
-                mFiber.reset(nullptr);
-                callback(res);
+        runTransaction<C>(args, callback, tell::store::TransactionType::READ_ONLY);
+    }
+
+private:
+    template<Command C>
+    using CommandTag = std::integral_constant<Command, C>;
+
+    SlotPool<Command::NEW_ORDER>& slotPool(CommandTag<Command::NEW_ORDER>) { return mNewOrderSlots; }
+    SlotPool<Command::PAYMENT>& slotPool(CommandTag<Command::PAYMENT>) { return mPaymentSlots; }
+    SlotPool<Command::ORDER_STATUS>& slotPool(CommandTag<Command::ORDER_STATUS>) { return mOrderStatusSlots; }
+    SlotPool<Command::DELIVERY>& slotPool(CommandTag<Command::DELIVERY>) { return mDeliverySlots; }
+    SlotPool<Command::STOCK_LEVEL>& slotPool(CommandTag<Command::STOCK_LEVEL>) { return mStockLevelSlots; }
+
+    // only NewOrder has a result which depends on the mode
+    NewOrderResult perform(tell::db::Transaction& tx, const NewOrderIn& in, ResultMode mode) {
+        return mTransactions.newOrderTransaction(tx, in, mode);
+    }
+
+    PaymentResult perform(tell::db::Transaction& tx, const PaymentIn& in, ResultMode) {
+        return mTransactions.payment(tx, in);
+    }
+
+    OrderStatusResult perform(tell::db::Transaction& tx, const OrderStatusIn& in, ResultMode) {
+        return mTransactions.orderStatus(tx, in);
+    }
+
+    DeliveryResult perform(tell::db::Transaction& tx, const DeliveryIn& in, ResultMode) {
+        return mTransactions.delivery(tx, in);
+    }
+
+    StockLevelResult perform(tell::db::Transaction& tx, const StockLevelIn& in, ResultMode) {
+        return mTransactions.stockLevel(tx, in);
+    }
+
+    /**
+     * Runs one of the benchmark transactions in a fiber as soon as the
+     * admission control lets it start - or answers right away with a busy
+     * error if it got rejected.
+     *
+     * All closures created on the way only capture this and the slot, so they
+     * fit into the small buffer of std::function and asio's handler memory.
+     */
+    template<Command C, class Callback>
+    void runTransaction(const typename Signature<C>::arguments& args, const Callback& callback,
+            tell::store::TransactionType type = tell::store::TransactionType::READ_WRITE) {
+        auto slot = slotPool(CommandTag<C>()).acquire();
+        slot->args = args;
+        slot->resultMode = mResultMode;
+        slot->callback = callback;
+        slot->type = type;
+        slot->start = Statistics::Clock::now();
+        slot->attempts = 0;
+        auto admitted = mAdmission.admit(mService, [this, slot]() {
+            startTransaction(slot);
+        });
+        if (!admitted) {
+            typename Signature<C>::result res;
+            res.success = false;
+            res.error = SERVER_BUSY;
+            res.abortReason = AbortReason::BUSY;
+            mStatistics.record(C, res, slot->start);
+            slotPool(CommandTag<C>()).release(slot);
+            callback(res);
+        }
+    }
+
+    template<Command C>
+    void startTransaction(TransactionSlot<C>* slot) {
+        ++slot->attempts;
+        if (mAffinity) {
+            mAffinity->service(slot->args.w_id).post([this, slot]() {
+                enterWarehouse(slot);
             });
-        };
-        mFiber.reset(new tell::db::TransactionFiber<void>(mClientManager.startTransaction(transaction,
-                        tell::store::TransactionType::READ_ONLY)));
+            return;
+        }
+        // the fiber can only finish on this thread, after the emplace
+        slot->fiber.emplace(mClientManager.startTransaction([this, slot](tell::db::Transaction& tx) {
+            slot->result = perform(tx, slot->args, slot->resultMode);
+            mService.post([this, slot]() {
+                finishTransaction(slot);
+            });
+        }, slot->type));
+    }
+
+    /**
+     * Runs on the thread of the warehouse - read-only transactions do not
+     * conflict on the hot tuples, so they never wait.
+     */
+    template<Command C>
+    void enterWarehouse(TransactionSlot<C>* slot) {
+        if (slot->type == tell::store::TransactionType::READ_ONLY) {
+            startInWarehouse(slot);
+            return;
+        }
+        mAffinity->enter(slot->args.w_id, [this, slot]() {
+            startInWarehouse(slot);
+        });
+    }
+
+    template<Command C>
+    void startInWarehouse(TransactionSlot<C>* slot) {
+        slot->fiber.emplace(mClientManager.startTransaction([this, slot](tell::db::Transaction& tx) {
+            slot->result = perform(tx, slot->args, slot->resultMode);
+            mAffinity->service(slot->args.w_id).post([this, slot]() {
+                leaveWarehouse(slot);
+            });
+        }, slot->type));
+    }
+
+    template<Command C>
+    void leaveWarehouse(TransactionSlot<C>* slot) {
+        slot->fiber->wait();
+        slot->fiber = boost::none;
+        if (slot->type != tell::store::TransactionType::READ_ONLY) {
+            mAffinity->leave(slot->args.w_id);
+        }
+        mService.post([this, slot]() {
+            finishTransaction(slot);
+        });
+    }
+
+    template<Command C>
+    void finishTransaction(TransactionSlot<C>* slot) {
+        // transactions which ran on the thread of their warehouse already waited for their fiber there
+        if (slot->fiber) {
+            slot->fiber->wait();
+            slot->fiber = boost::none;
+        }
+        if (!slot->result.success && mRetryPolicy.retry(slot->result.abortReason, slot->attempts)) {
+            retryTransaction(slot);
+            return;
+        }
+        mAdmission.release();
+        slot->result.attempts = slot->attempts;
+        mStatistics.record(C, slot->result, slot->start);
+        auto callback = std::move(slot->callback);
+        auto result = std::move(slot->result);
+        slotPool(CommandTag<C>()).release(slot);
+        // the callback may close the connection and delete this
+        callback(result);
+    }
+
+    /**
+     * Runs an aborted transaction again after the backoff. It keeps its
+     * admission in the meantime, a retry should not queue up behind
+     * transactions which arrived later.
+     */
+    template<Command C>
+    void retryTransaction(TransactionSlot<C>* slot) {
+        mStatistics.recordRetry(C);
+        if (!slot->timer) {
+            slot->timer.emplace(mService);
+        }
+        slot->timer->expires_from_now(mRetryPolicy.backoff(slot->attempts));
+        slot->timer->async_wait([this, slot](const boost::system::error_code&) {
+            startTransaction(slot);
+        });
+    }
+
+    /**
+     * The transaction has to post its completion to mService, which has to
+     * call finishFiber with the same key - that can never happen before the
+     * fiber got registered here.
+     */
+    void startFiber(uint64_t key, std::function<void(tell::db::Transaction&)> transaction,
+            tell::store::TransactionType type = tell::store::TransactionType::READ_WRITE) {
+        mFibers.emplace(key, std::unique_ptr<tell::db::TransactionFiber<void>>(
+                    new tell::db::TransactionFiber<void>(mClientManager.startTransaction(std::move(transaction), type))));
+    }
+
+    void finishFiber(uint64_t key) {
+        auto iter = mFibers.find(key);
+        assert(iter != mFibers.end());
+        iter->second->wait();
+        mFibers.erase(iter);
     }
 };
 
-Connection::Connection(boost::asio::io_service& service, tell::db::ClientManager<void>& clientManager, int16_t numWarehouses)
-    : mSocket(service)
-    , mImpl(new CommandImpl(this, mSocket, service, clientManager, numWarehouses))
+Connection::Connection(std::unique_ptr<Stream> stream, ServicePool& pool, AdmissionControl& admission,
+        Statistics& statistics, const RetryPolicy& retryPolicy, WarehouseAffinity* affinity,
+        DeliveryQueue* deliveries, ItemCache* items, tell::db::ClientManager<void>& clientManager,
+        TableCatalog& catalog)
+    : mStream(std::move(stream))
+    , mImpl(new CommandImpl(this, *mStream, mStream->service(), pool, admission, statistics, retryPolicy, affinity,
+                deliveries, items, clientManager, catalog))
 {}
 
 Connection::~Connection() = default;
 
 void Connection::run() {
-    mImpl->run();
+    auto impl = mImpl.get();
+    mStream->service().post([impl]() {
+        impl->run();
+    });
 }
 
 } // namespace tpcc
@@ -31,14 +31,26 @@
 namespace tpcc {
 
 class CommandImpl;
+class ServicePool;
+class AdmissionControl;
+class Statistics;
+class RetryPolicy;
+class WarehouseAffinity;
+class TableCatalog;
+class DeliveryQueue;
+class ItemCache;
 
 class Connection {
-    boost::asio::ip::tcp::socket mSocket;
+    std::unique_ptr<Stream> mStream;
     std::unique_ptr<CommandImpl> mImpl;
 public:
-    Connection(boost::asio::io_service& service, tell::db::ClientManager<void>& clientManager, int16_t numWarehouses);
+    Connection(std::unique_ptr<Stream> stream, ServicePool& pool, AdmissionControl& admission,
+            Statistics& statistics, const RetryPolicy& retryPolicy, WarehouseAffinity* affinity,
+            DeliveryQueue* deliveries, ItemCache* items, tell::db::ClientManager<void>& clientManager, TableCatalog& catalog);
     ~Connection();
-    decltype(mSocket)& socket() { return mSocket; }
+    /**
+     * Starts serving requests - can be called from any thread.
+     */
     void run();
 };
 
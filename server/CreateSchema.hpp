@@ -36,7 +36,25 @@ class Transaction;
 
 namespace tpcc {
 
-void createSchema(tell::db::Transaction& transaction, bool useCH);
+/**
+ * Optional vertical partitioning of hot tables. The schema gets created,
+ * populated and used with the layout the server was started with, so all
+ * servers of a run need the same one.
+ */
+struct SchemaLayout {
+    // order-line gets an index covering ol_i_id, which turns the order and
+    // order-line reads of StockLevel into one range scan - at the price of
+    // maintaining the index on every order-line NewOrder inserts
+    bool orderLineIndex = false;
+    // stock is stored as stock_counters (what NewOrder updates) and
+    // stock_info (the texts), both with the key of stock
+    bool splitStock = false;
+    // customer is stored as customer_core (names, credit and the balances)
+    // and customer_info (address and c_data), both with the key of customer
+    bool splitCustomer = false;
+};
+
+void createSchema(tell::db::Transaction& transaction, bool useCH, const SchemaLayout& layout);
 
 struct WarehouseKey {
     int16_t w_id;
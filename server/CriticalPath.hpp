@@ -0,0 +1,83 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <algorithm>
+#include <utility>
+
+#include <telldb/Transaction.hpp>
+
+namespace tpcc {
+
+/**
+ * Measures the critical path of a transaction in round trips to the storage.
+ *
+ * The transactions are written such that every request is issued as soon as
+ * its inputs are known. Each request remembers how many round trips it took
+ * to learn its inputs, waiting for it makes the path one longer than that:
+ * requests issued together cost one round trip, no matter how many of them
+ * there are, but a request which needs the result of another one adds to the
+ * path. Blocking calls like index lookups count through sync.
+ */
+class CriticalPath {
+    unsigned mLength = 0;
+public:
+    /**
+     * A request which is in flight
+     */
+    template<class T>
+    class Request {
+        tell::db::Future<T> mFuture;
+        CriticalPath* mPath;
+        unsigned mIssuedAt;
+    public:
+        Request(tell::db::Future<T> future, CriticalPath& path)
+            : mFuture(std::move(future))
+            , mPath(&path)
+            , mIssuedAt(path.mLength)
+        {}
+
+        T get() {
+            mPath->mLength = std::max(mPath->mLength, mIssuedAt + 1);
+            return mFuture.get();
+        }
+    };
+
+    template<class T>
+    Request<T> issue(tell::db::Future<T> future) {
+        return Request<T>(std::move(future), *this);
+    }
+
+    /**
+     * Accounts for a blocking request which depends on everything waited for
+     * so far
+     */
+    void sync() {
+        ++mLength;
+    }
+
+    unsigned length() const {
+        return mLength;
+    }
+};
+
+} // namespace tpcc
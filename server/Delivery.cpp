@@ -23,72 +23,111 @@
 #include "Transactions.hpp"
 #include "CreateSchema.hpp"
 
+#include <boost/container/static_vector.hpp>
+
 using namespace tell::db;
 
 namespace tpcc {
 
-DeliveryResult Transactions::delivery(Transaction& tx, const DeliveryIn& in) {
+namespace {
+
+// customer and customer_core both have the balance and the delivery count
+template<class Table>
+void addDelivery(const Columns<Table>& columns, Tuple& customer, int64_t amount) {
+    columns.template at<typename Table::c_balance>(customer) += Field(amount);
+    columns.template at<typename Table::c_delivery_cnt>(customer) += Field(int16_t(1));
+}
+
+} // anonymous namespace
+
+DeliveryResult Transactions::delivery(Transaction& tx, const DeliveryIn& in, std::array<int32_t, 10>* delivered) {
     DeliveryResult result;
     try {
-        auto noTableF = tx.openTable("new-order");
-        auto oTableF = tx.openTable("order");
-        auto olTableF = tx.openTable("order-line");
-        auto cTableF = tx.openTable("customer");
-        auto cTable = cTableF.get();
-        auto olTable = olTableF.get();
-        auto oTable = oTableF.get();
-        auto noTable = noTableF.get();
+        std::array<int32_t, 10> deliveredOrders;
+        deliveredOrders.fill(0);
+        auto tables = mCatalog.tables(tx);
+        auto cTable = tables->customer;
+        auto olTable = tables->orderLine;
+        auto oTable = tables->order;
+        auto noTable = tables->newOrder;
         auto ol_delivery_d = now();
+        // The districts do not depend on each other, so every step is done for
+        // all of them before waiting for the first result: the latency is the
+        // one of a single district instead of the sum of ten.
+        CriticalPath path;
+        // find the oldest new order of every district
+        boost::container::static_vector<NewOrderKey, 10> noKeys;
         for (int16_t d_id = 1; d_id <= 10; ++d_id) {
-            auto iter = tx.lower_bound(noTable, "new-order-idx", {
+            auto iter = tx.lower_bound(noTable, tables->newOrderIdx, {
                     Field(in.w_id),
                     Field(d_id),
                     Field(int32_t(0))});
+            path.sync();
             if (iter.done()) continue;
             NewOrderKey noKey{iter.value()};
             if (noKey.w_id != in.w_id || noKey.d_id != d_id) continue;
-            OrderKey oKey{in.w_id, d_id, noKey.o_id};
-            auto newOrderF = tx.get(noTable, noKey.key());
-            auto orderF = tx.get(oTable, oKey.key());
-            auto order = orderF.get();
+            deliveredOrders[d_id - 1] = noKey.o_id;
+            noKeys.push_back(noKey);
+        }
+        // get all new orders and orders
+        boost::container::static_vector<CriticalPath::Request<Tuple>, 10> newOrdersF;
+        boost::container::static_vector<CriticalPath::Request<Tuple>, 10> ordersF;
+        for (const auto& noKey : noKeys) {
+            newOrdersF.emplace_back(path.issue(tx.get(noTable, noKey.key())));
+            ordersF.emplace_back(path.issue(tx.get(oTable, OrderKey{in.w_id, noKey.d_id, noKey.o_id}.key())));
+        }
+        // the order lines and the customer of an order get requested as soon
+        // as the order arrived
+        using OrderLines = boost::container::static_vector<CriticalPath::Request<Tuple>, MAX_ORDER_LINES>;
+        boost::container::static_vector<OrderLines, 10> orderLinesF(noKeys.size());
+        boost::container::static_vector<CriticalPath::Request<Tuple>, 10> customersF;
+        boost::container::static_vector<CustomerKey, 10> cKeys;
+        for (size_t i = 0; i < noKeys.size(); ++i) {
+            auto d_id = noKeys[i].d_id;
+            OrderKey oKey{in.w_id, d_id, noKeys[i].o_id};
+            auto order = ordersF[i].get();
             auto nOrder = order;
-
-            auto newOrder = newOrderF.get();
-            tx.remove(noTable, noKey.key(), newOrder);
-            nOrder.at("o_carrier_id") = Field(in.o_carrier_id);
+            tables->orderColumns.at<schema::Order::o_carrier_id>(nOrder) = Field(in.o_carrier_id);
             tx.update(oTable, oKey.key(), order, nOrder);
-            auto o_ol_cnt = order.at("o_ol_cnt").value<int16_t>();
-            std::vector<Future<Tuple>> orderLinesF;
-            orderLinesF.reserve(o_ol_cnt);
-            std::vector<tell::db::key_t> ol_keys;
-            ol_keys.reserve(o_ol_cnt);
+            auto o_ol_cnt = tables->orderColumns.get<schema::Order::o_ol_cnt>(order);
             for (decltype(o_ol_cnt) ol_number = 1; ol_number <= o_ol_cnt; ++ol_number) {
                 OrderlineKey olKey(in.w_id, d_id, oKey.o_id, ol_number);
-                auto k = olKey.key();
-                orderLinesF.emplace_back(tx.get(olTable, k));
-                ol_keys.emplace_back(k);
+                orderLinesF[i].emplace_back(path.issue(tx.get(olTable, olKey.key())));
             }
-            CustomerKey cKey{in.w_id, d_id, order.at("o_c_id").value<int32_t>()};
-            auto customerF = tx.get(cTable, cKey.key());
-            auto customer = customerF.get();
+            cKeys.emplace_back(in.w_id, d_id, tables->orderColumns.get<schema::Order::o_c_id>(order));
+            customersF.emplace_back(path.issue(tx.get(cTable, cKeys.back().key())));
+        }
+        for (size_t i = 0; i < noKeys.size(); ++i) {
+            auto newOrder = newOrdersF[i].get();
+            tx.remove(noTable, noKeys[i].key(), newOrder);
             int64_t amount = 0;
-            for (size_t i = orderLinesF.size(); i > 0; --i) {
-                auto orderline = orderLinesF[i - 1].get();
+            for (size_t j = orderLinesF[i].size(); j > 0; --j) {
+                OrderlineKey olKey(in.w_id, noKeys[i].d_id, noKeys[i].o_id, int16_t(j));
+                auto orderline = orderLinesF[i][j - 1].get();
                 auto nOrderline = orderline;
-                amount += orderline.at("ol_amount").value<int32_t>();
-                nOrderline.at("ol_delivery_d") = Field(ol_delivery_d);
-                tx.update(olTable, ol_keys[i - 1], orderline, nOrderline);
+                amount += tables->orderLineColumns.get<schema::OrderLine::ol_amount>(orderline);
+                tables->orderLineColumns.at<schema::OrderLine::ol_delivery_d>(nOrderline) = Field(ol_delivery_d);
+                tx.update(olTable, olKey.key(), orderline, nOrderline);
             }
+            auto customer = customersF[i].get();
             auto nCustomer = customer;
-            nCustomer.at("c_balance") += Field(amount);
-            nCustomer.at("c_delivery_cnt") += Field(int16_t(1));
-            tx.update(cTable, cKey.key(), customer, nCustomer);
+            if (tables->splitCustomer) {
+                addDelivery(tables->customerCoreColumns, nCustomer, amount);
+            } else {
+                addDelivery(tables->customerColumns, nCustomer, amount);
+            }
+            tx.update(cTable, cKeys[i].key(), customer, nCustomer);
         }
         tx.commit();
+        mStatistics.recordCriticalPath(Command::DELIVERY, path.length());
+        if (delivered) {
+            *delivered = deliveredOrders;
+        }
         result.success = true;
     } catch (std::exception& ex) {
         result.success = false;
         result.error = ex.what();
+        result.abortReason = classifyAbort(ex);
     }
     return result;
 }
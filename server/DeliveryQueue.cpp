@@ -0,0 +1,168 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "DeliveryQueue.hpp"
+#include "ServicePool.hpp"
+#include "Statistics.hpp"
+#include "RetryPolicy.hpp"
+#include "Transactions.hpp"
+
+#include <crossbow/logger.hpp>
+
+namespace tpcc {
+
+DeliveryQueue::DeliveryQueue(ServicePool& pool, tell::db::ClientManager<void>& clientManager, TableCatalog& catalog,
+        Statistics& statistics, const RetryPolicy& retryPolicy, unsigned numWorkers,
+        size_t capacity, const std::string& logPath)
+    : mClientManager(clientManager)
+    , mStatistics(statistics)
+    , mRetryPolicy(retryPolicy)
+    , mCapacity(capacity)
+    , mTransactions(new Transactions(catalog, statistics, nullptr))
+{
+    for (unsigned i = 0; i < numWorkers; ++i) {
+        mWorkers.emplace_back(new Worker());
+        mWorkers.back()->service = &pool.service(i % pool.size());
+        mIdle.push_back(mWorkers.back().get());
+    }
+    if (!logPath.empty()) {
+        mLog.open(logPath.c_str());
+        if (!mLog) {
+            LOG_ERROR("Could not open delivery log %1%", logPath);
+        }
+        mLog << "w_id,o_carrier_id,queue_us,execution_us,success,attempts,delivered_orders\n";
+    }
+}
+
+DeliveryQueue::~DeliveryQueue() {
+    {
+        std::lock_guard<std::mutex> _(mMutex);
+        mStopping = true;
+        mQueue.clear();
+    }
+    // A running transaction still uses its worker, mTransactions and the log,
+    // so they can only go once it is done
+    for (auto& worker : mWorkers) {
+        if (worker->fiber) {
+            worker->fiber->wait();
+        }
+        if (worker->timer) {
+            boost::system::error_code ec;
+            worker->timer->cancel(ec);
+        }
+    }
+}
+
+bool DeliveryQueue::push(const DeliveryIn& in) {
+    Request request{in, Clock::now()};
+    Worker* worker;
+    {
+        std::lock_guard<std::mutex> _(mMutex);
+        if (mStopping) {
+            return false;
+        }
+        if (mIdle.empty()) {
+            if (mCapacity != 0 && mQueue.size() >= mCapacity) {
+                return false;
+            }
+            mQueue.push_back(request);
+            return true;
+        }
+        worker = mIdle.back();
+        mIdle.pop_back();
+    }
+    worker->request = request;
+    worker->start = Clock::now();
+    worker->attempts = 0;
+    worker->service->post([this, worker]() {
+        start(worker);
+    });
+    return true;
+}
+
+void DeliveryQueue::start(Worker* worker) {
+    ++worker->attempts;
+    worker->delivered.fill(0);
+    // the fiber can only finish on the thread of the worker, after the emplace
+    worker->fiber.emplace(mClientManager.startTransaction([this, worker](tell::db::Transaction& tx) {
+        worker->result = mTransactions->delivery(tx, worker->request.in, &worker->delivered);
+        worker->service->post([this, worker]() {
+            finish(worker);
+        });
+    }));
+}
+
+void DeliveryQueue::finish(Worker* worker) {
+    worker->fiber->wait();
+    worker->fiber = boost::none;
+    if (!worker->result.success && mRetryPolicy.retry(worker->result.abortReason, worker->attempts)) {
+        mStatistics.recordRetry(Command::DELIVERY);
+        if (!worker->timer) {
+            worker->timer.emplace(*worker->service);
+        }
+        worker->timer->expires_from_now(mRetryPolicy.backoff(worker->attempts));
+        worker->timer->async_wait([this, worker](const boost::system::error_code& ec) {
+            if (ec) {
+                // cancelled by the destructor
+                return;
+            }
+            start(worker);
+        });
+        return;
+    }
+    worker->result.attempts = worker->attempts;
+    // the latency of a deferred delivery includes the time it was queued
+    mStatistics.record(Command::DELIVERY, worker->result, worker->request.queued);
+    log(*worker, Clock::now());
+    {
+        std::lock_guard<std::mutex> _(mMutex);
+        if (mStopping || mQueue.empty()) {
+            mIdle.push_back(worker);
+            return;
+        }
+        worker->request = mQueue.front();
+        mQueue.pop_front();
+    }
+    worker->start = Clock::now();
+    worker->attempts = 0;
+    start(worker);
+}
+
+void DeliveryQueue::log(const Worker& worker, Clock::time_point end) {
+    if (!mLog.is_open()) {
+        return;
+    }
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    std::lock_guard<std::mutex> _(mLogMutex);
+    mLog << worker.request.in.w_id << ',' << worker.request.in.o_carrier_id << ','
+        << duration_cast<microseconds>(worker.start - worker.request.queued).count() << ','
+        << duration_cast<microseconds>(end - worker.start).count() << ','
+        << (worker.result.success ? "true" : "false") << ','
+        << worker.attempts << ',';
+    for (size_t d = 0; d < worker.delivered.size(); ++d) {
+        mLog << (d == 0 ? "" : " ") << worker.delivered[d];
+    }
+    mLog << '\n';
+}
+
+} // namespace tpcc
@@ -0,0 +1,123 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/optional.hpp>
+
+#include <common/Protocol.hpp>
+#include <telldb/TellDB.hpp>
+
+namespace tpcc {
+
+class ServicePool;
+class Statistics;
+class RetryPolicy;
+class TableCatalog;
+class Transactions;
+
+/**
+ * Executes Delivery transactions in the background.
+ *
+ * TPC-C defines Delivery as deferred (clause 2.7): the terminal only waits
+ * until the request got queued, the actual work is done later. A Delivery
+ * pushed here gets acknowledged right away and is executed by one of a fixed
+ * number of workers as soon as one becomes idle. Every executed delivery gets
+ * a line in the completion log with the time it spent in the queue and the
+ * time its execution took, together with the order delivered per district
+ * (0 if a district had nothing to deliver).
+ *
+ * Every worker lives on one of the threads of the pool, all its handlers run
+ * there. Only the queue itself is shared and protected by a mutex.
+ */
+class DeliveryQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+    using DeliveredOrders = std::array<int32_t, 10>;
+private:
+    struct Request {
+        DeliveryIn in;
+        Clock::time_point queued;
+    };
+    struct Worker {
+        boost::asio::io_service* service;
+        Request request;
+        Clock::time_point start;
+        unsigned attempts;
+        DeliveryResult result;
+        DeliveredOrders delivered;
+        boost::optional<tell::db::TransactionFiber<void>> fiber;
+        boost::optional<boost::asio::steady_timer> timer;
+    };
+    tell::db::ClientManager<void>& mClientManager;
+    Statistics& mStatistics;
+    const RetryPolicy& mRetryPolicy;
+    size_t mCapacity;
+    std::unique_ptr<Transactions> mTransactions;
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+    std::mutex mMutex;
+    std::deque<Request> mQueue;
+    std::vector<Worker*> mIdle;
+    bool mStopping = false;
+    std::mutex mLogMutex;
+    std::ofstream mLog;
+public:
+    /**
+     * A capacity of 0 means unlimited, an empty log path disables the
+     * completion log.
+     */
+    DeliveryQueue(ServicePool& pool, tell::db::ClientManager<void>& clientManager, TableCatalog& catalog,
+            Statistics& statistics, const RetryPolicy& retryPolicy, unsigned numWorkers,
+            size_t capacity, const std::string& logPath);
+
+    /**
+     * Drops the queued deliveries and waits for the running ones - has to be
+     * called after the pool stopped, their handlers are not executed anymore.
+     */
+    ~DeliveryQueue();
+
+    /**
+     * Queues a delivery - returns false if the queue is full or the queue is
+     * being destroyed. Can be called from any thread.
+     */
+    bool push(const DeliveryIn& in);
+
+private:
+    void start(Worker* worker);
+
+    void finish(Worker* worker);
+
+    void log(const Worker& worker, Clock::time_point end);
+};
+
+} // namespace tpcc
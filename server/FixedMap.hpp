@@ -0,0 +1,98 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <cstddef>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+#include <boost/container/static_vector.hpp>
+
+namespace tpcc {
+
+/**
+ * A map with a capacity fixed at compile time which stores its entries inline.
+ *
+ * Lookups are linear scans - for the handful of entries of a transaction (at
+ * most 15 order lines) this is faster than hashing and it never allocates.
+ */
+template<class Key, class Value, size_t N>
+class FixedMap {
+    using Entries = boost::container::static_vector<std::pair<Key, Value>, N>;
+    Entries mEntries;
+public:
+    using iterator = typename Entries::iterator;
+    using const_iterator = typename Entries::const_iterator;
+
+    iterator begin() { return mEntries.begin(); }
+    iterator end() { return mEntries.end(); }
+    const_iterator begin() const { return mEntries.begin(); }
+    const_iterator end() const { return mEntries.end(); }
+
+    size_t size() const {
+        return mEntries.size();
+    }
+
+    iterator find(const Key& key) {
+        auto iter = mEntries.begin();
+        for (; iter != mEntries.end() && !(iter->first == key); ++iter);
+        return iter;
+    }
+
+    const_iterator find(const Key& key) const {
+        return const_cast<FixedMap*>(this)->find(key);
+    }
+
+    size_t count(const Key& key) const {
+        return find(key) == end() ? 0 : 1;
+    }
+
+    Value& at(const Key& key) {
+        auto iter = find(key);
+        if (iter == end()) {
+            throw std::out_of_range("FixedMap::at");
+        }
+        return iter->second;
+    }
+
+    const Value& at(const Key& key) const {
+        return const_cast<FixedMap*>(this)->at(key);
+    }
+
+    /**
+     * Inserts the entry if the key is not there yet - throws std::bad_alloc
+     * if the map is full.
+     */
+    template<class... Args>
+    std::pair<iterator, bool> emplace(const Key& key, Args&&... args) {
+        auto iter = find(key);
+        if (iter != end()) {
+            return std::make_pair(iter, false);
+        }
+        mEntries.emplace_back(std::piecewise_construct, std::forward_as_tuple(key),
+                std::forward_as_tuple(std::forward<Args>(args)...));
+        return std::make_pair(mEntries.end() - 1, true);
+    }
+};
+
+} // namespace tpcc
@@ -0,0 +1,50 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "HistoryIds.hpp"
+
+#include <telldb/Transaction.hpp>
+
+namespace tpcc {
+
+constexpr uint64_t HistoryIds::BLOCK_SIZE;
+
+uint64_t HistoryIds::next(tell::db::Transaction& tx, uint64_t generation) {
+    {
+        std::lock_guard<std::mutex> _(mMutex);
+        if (mGeneration == generation && mNext != mEnd) {
+            return mNext++;
+        }
+    }
+    // we must not hold the mutex while waiting for the counter - if another
+    // fiber refilled in the meantime its block wins and ours gets dropped
+    auto block = tx.getCounter("history_counter").next();
+    std::lock_guard<std::mutex> _(mMutex);
+    if (mGeneration != generation || mNext == mEnd) {
+        mGeneration = generation;
+        mNext = block * BLOCK_SIZE;
+        mEnd = mNext + BLOCK_SIZE;
+    }
+    return mNext++;
+}
+
+} // namespace tpcc
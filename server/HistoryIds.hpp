@@ -0,0 +1,66 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <cstdint>
+#include <mutex>
+
+namespace tell {
+namespace db {
+
+class Transaction;
+
+} // namespace db
+} // namespace tell
+
+namespace tpcc {
+
+/**
+ * Hands out keys for the history table.
+ *
+ * Every call to the shared history counter is a round trip to the storage,
+ * so instead of asking it for each row an allocator takes a whole block of
+ * BLOCK_SIZE keys at once and hands them out locally: the counter value n
+ * stands for the keys [n * BLOCK_SIZE, (n + 1) * BLOCK_SIZE). All writers of
+ * the history table have to go through an allocator, otherwise keys collide.
+ *
+ * Keys left over in a block are simply lost, history keys only have to be
+ * unique. An allocator may be shared by the fibers of one connection.
+ */
+class HistoryIds {
+    std::mutex mMutex;
+    uint64_t mNext = 0;
+    uint64_t mEnd = 0;
+    uint64_t mGeneration = 0;
+public:
+    static constexpr uint64_t BLOCK_SIZE = 10000;
+
+    /**
+     * Returns the next unused key, reserves a new block within tx if the
+     * current one is exhausted. A block reserved under another schema
+     * generation (see TableCatalog) is dropped, the counter starts over when
+     * the schema gets created again.
+     */
+    uint64_t next(tell::db::Transaction& tx, uint64_t generation = 0);
+};
+
+} // namespace tpcc
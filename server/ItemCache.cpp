@@ -0,0 +1,107 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "ItemCache.hpp"
+#include "TableCatalog.hpp"
+
+#include <telldb/Transaction.hpp>
+#include <crossbow/logger.hpp>
+
+#include <algorithm>
+#include <atomic>
+
+namespace tpcc {
+
+namespace {
+
+// number of gets in flight per loading transaction
+constexpr int32_t LOAD_BATCH = 1000;
+
+} // anonymous namespace
+
+bool ItemCache::load() {
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> _(mMutex);
+        generation = mGeneration;
+        std::atomic_store(&mItems, std::shared_ptr<const Items>());
+    }
+    auto items = std::make_shared<Items>();
+    items->mPrice.resize(NUM_ITEMS);
+    items->mName.resize(NUM_ITEMS);
+    items->mOriginal.resize(NUM_ITEMS);
+    // every transaction writes a disjoint range of the columns
+    std::atomic<bool> failed(false);
+    std::vector<tell::db::TransactionFiber<void>> fibers;
+    fibers.reserve(mParallelism);
+    for (unsigned i = 0; i < mParallelism; ++i) {
+        int32_t first = int32_t(NUM_ITEMS * uint64_t(i) / mParallelism) + 1;
+        int32_t last = int32_t(NUM_ITEMS * uint64_t(i + 1) / mParallelism);
+        fibers.emplace_back(mClientManager.startTransaction(
+                    [this, &items, &failed, first, last](tell::db::Transaction& tx) {
+            try {
+                auto tables = mCatalog.tables(tx);
+                std::vector<tell::db::Future<tell::db::Tuple>> itemsF;
+                itemsF.reserve(LOAD_BATCH);
+                for (auto batch = first; batch <= last; batch += LOAD_BATCH) {
+                    auto end = std::min(batch + LOAD_BATCH - 1, last);
+                    itemsF.clear();
+                    for (auto i_id = batch; i_id <= end; ++i_id) {
+                        itemsF.emplace_back(tx.get(tables->item, tell::db::key_t{uint64_t(i_id)}));
+                    }
+                    for (auto i_id = batch; i_id <= end; ++i_id) {
+                        auto item = itemsF[i_id - batch].get();
+                        items->mPrice[i_id - 1] = tables->itemColumns.get<schema::Item::i_price>(item);
+                        items->mName[i_id - 1] = tables->itemColumns.get<schema::Item::i_name>(item);
+                        const auto& i_data = tables->itemColumns.get<schema::Item::i_data>(item);
+                        items->mOriginal[i_id - 1] = i_data.find("ORIGINAL") != i_data.npos;
+                    }
+                }
+                tx.commit();
+            } catch (std::exception& ex) {
+                LOG_INFO("Could not load items: %1%", ex.what());
+                failed = true;
+                tx.rollback();
+            }
+        }, tell::store::TransactionType::READ_ONLY));
+    }
+    for (auto& fiber : fibers) {
+        fiber.wait();
+    }
+    if (failed) {
+        return false;
+    }
+    std::lock_guard<std::mutex> _(mMutex);
+    if (generation != mGeneration) {
+        return false;
+    }
+    std::atomic_store(&mItems, std::shared_ptr<const Items>(std::move(items)));
+    return true;
+}
+
+void ItemCache::invalidate() {
+    std::lock_guard<std::mutex> _(mMutex);
+    ++mGeneration;
+    std::atomic_store(&mItems, std::shared_ptr<const Items>());
+}
+
+} // namespace tpcc
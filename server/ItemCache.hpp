@@ -0,0 +1,106 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <crossbow/string.hpp>
+#include <common/Protocol.hpp>
+#include <telldb/TellDB.hpp>
+
+namespace tpcc {
+
+class TableCatalog;
+
+/**
+ * An immutable, in-process copy of the item table.
+ *
+ * The 100000 items never change after POPULATE_DIM_TABLES, so NewOrder does
+ * not have to get them from the storage. The cache holds only what NewOrder
+ * needs, one column per attribute: the price, the name and whether i_data
+ * contains "ORIGINAL", which is decided once while loading.
+ *
+ * Loading reads the whole table with a few read-only transactions in parallel
+ * and publishes the result only if all of them succeeded. As long as nothing
+ * is loaded, callers have to read through to the storage.
+ */
+class ItemCache {
+public:
+    class Items {
+        friend class ItemCache;
+        std::vector<int32_t> mPrice;
+        std::vector<crossbow::string> mName;
+        std::vector<uint8_t> mOriginal;
+    public:
+        bool contains(int32_t i_id) const {
+            return i_id >= 1 && i_id <= int32_t(mPrice.size());
+        }
+
+        int32_t price(int32_t i_id) const {
+            return mPrice[i_id - 1];
+        }
+
+        const crossbow::string& name(int32_t i_id) const {
+            return mName[i_id - 1];
+        }
+
+        bool original(int32_t i_id) const {
+            return mOriginal[i_id - 1] != 0;
+        }
+    };
+private:
+    tell::db::ClientManager<void>& mClientManager;
+    TableCatalog& mCatalog;
+    unsigned mParallelism;
+    std::mutex mMutex;
+    std::shared_ptr<const Items> mItems;
+    // incremented on every invalidation, a load which raced with it is dropped
+    uint64_t mGeneration = 0;
+public:
+    ItemCache(tell::db::ClientManager<void>& clientManager, TableCatalog& catalog, unsigned parallelism)
+        : mClientManager(clientManager)
+        , mCatalog(catalog)
+        , mParallelism(parallelism == 0 ? 1 : parallelism)
+    {}
+
+    /**
+     * The loaded items or nullptr - can be called from any thread.
+     */
+    std::shared_ptr<const Items> items() const {
+        return std::atomic_load(&mItems);
+    }
+
+    /**
+     * (Re)loads the item table and blocks the calling thread until it is
+     * done, so this must not be called from within a transaction. Returns
+     * false if the table could not be read completely, the cache is empty
+     * then.
+     */
+    bool load();
+
+    void invalidate();
+};
+
+} // namespace tpcc
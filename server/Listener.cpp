@@ -0,0 +1,126 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "Listener.hpp"
+#include "ServicePool.hpp"
+
+#include <stdexcept>
+#include <unistd.h>
+
+#include <crossbow/logger.hpp>
+
+namespace tpcc {
+
+Listener::Listener(ServicePool& pool, Transport transport, const std::string& host, const std::string& port)
+    : mPool(pool)
+    , mTransport(transport)
+    , mTcpAcceptor(pool.acceptorService())
+    , mLocalAcceptor(pool.acceptorService())
+{
+    using boost::asio::ip::tcp;
+    if (transport != Transport::TCP) {
+        auto path = localPath(host, port);
+        // a server which did not shut down cleanly leaves its socket file behind
+        unlink(path.c_str());
+        boost::asio::local::stream_protocol::endpoint endpoint(path);
+        mLocalAcceptor.open(endpoint.protocol());
+        mLocalAcceptor.bind(endpoint);
+        mLocalAcceptor.listen();
+        return;
+    }
+    tcp::acceptor::reuse_address option(true);
+    tcp::resolver resolver(pool.acceptorService());
+    tcp::resolver::iterator iter;
+    if (host == "") {
+        iter = resolver.resolve(tcp::resolver::query(port));
+    } else {
+        iter = resolver.resolve(tcp::resolver::query(host, port));
+    }
+    tcp::resolver::iterator end;
+    for (; iter != end; ++iter) {
+        boost::system::error_code err;
+        auto endpoint = iter->endpoint();
+        auto protocol = iter->endpoint().protocol();
+        mTcpAcceptor.open(protocol);
+        mTcpAcceptor.set_option(option);
+        mTcpAcceptor.bind(endpoint, err);
+        if (err) {
+            mTcpAcceptor.close();
+            LOG_WARN("Bind attempt failed " + err.message());
+            continue;
+        }
+        break;
+    }
+    if (!mTcpAcceptor.is_open()) {
+        throw std::runtime_error("Could not bind");
+    }
+    mTcpAcceptor.listen();
+}
+
+void Listener::accept(Callback callback) {
+    mCallback = std::move(callback);
+    if (mTransport == Transport::TCP) {
+        acceptTcp();
+    } else {
+        acceptLocal();
+    }
+}
+
+void Listener::acceptTcp() {
+    auto stream = new TcpStream(mPool.next());
+    mTcpAcceptor.async_accept(stream->socket(), [this, stream](const boost::system::error_code& err) {
+        if (err) {
+            delete stream;
+            LOG_ERROR(err.message());
+            return;
+        }
+        stream->service().post([this, stream]() {
+            mCallback(std::unique_ptr<Stream>(stream));
+        });
+        acceptTcp();
+    });
+}
+
+void Listener::acceptLocal() {
+    auto stream = new UnixStream(mPool.next());
+    mLocalAcceptor.async_accept(stream->socket(), [this, stream](const boost::system::error_code& err) {
+        if (err) {
+            delete stream;
+            LOG_ERROR(err.message());
+            return;
+        }
+        stream->service().post([this, stream]() {
+            if (mTransport == Transport::UNIX) {
+                mCallback(std::unique_ptr<Stream>(stream));
+                return;
+            }
+            ShmStream::accept(std::unique_ptr<UnixStream>(stream), [this](std::unique_ptr<Stream> shm) {
+                if (shm) {
+                    mCallback(std::move(shm));
+                }
+            });
+        });
+        acceptLocal();
+    });
+}
+
+} // namespace tpcc
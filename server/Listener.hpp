@@ -0,0 +1,66 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include <boost/asio.hpp>
+
+#include <common/Transport.hpp>
+
+namespace tpcc {
+
+class ServicePool;
+
+/**
+ * Accepts client connections over one of the transports.
+ *
+ * Every accepted stream is bound to the next service of the pool and handed
+ * to the callback on the thread of that service.
+ */
+class Listener {
+public:
+    using Callback = std::function<void(std::unique_ptr<Stream>)>;
+private:
+    ServicePool& mPool;
+    Transport mTransport;
+    boost::asio::ip::tcp::acceptor mTcpAcceptor;
+    boost::asio::local::stream_protocol::acceptor mLocalAcceptor;
+    Callback mCallback;
+public:
+    /**
+     * Binds to host:port for TCP and to the socket path for the local
+     * transports - throws if that is not possible.
+     */
+    Listener(ServicePool& pool, Transport transport, const std::string& host, const std::string& port);
+
+    /**
+     * Accepts connections until the pool gets stopped
+     */
+    void accept(Callback callback);
+private:
+    void acceptTcp();
+    void acceptLocal();
+};
+
+} // namespace tpcc
@@ -22,8 +22,11 @@
  */
 #include "Transactions.hpp"
 #include "CreateSchema.hpp"
+#include "FixedMap.hpp"
 #include <common/Util.hpp>
 
+#include <telldb/Exceptions.hpp>
+
 using namespace tell::db;
 
 namespace tpcc {
@@ -37,60 +40,122 @@ struct NewStock {
     int16_t s_remote_cnt;
 };
 
+// the counters are the same columns in stock and stock_counters
+template<class Table>
+NewStock readCounters(const Columns<Table>& columns, const Tuple& stock) {
+    NewStock res;
+    res.s_quantity = columns.template get<typename Table::s_quantity>(stock);
+    res.s_ytd = columns.template get<typename Table::s_ytd>(stock);
+    res.s_order_cnt = columns.template get<typename Table::s_order_cnt>(stock);
+    res.s_remote_cnt = columns.template get<typename Table::s_remote_cnt>(stock);
+    return res;
+}
+
+template<class Table>
+void writeCounters(const Columns<Table>& columns, Tuple& stock, const NewStock& nStock) {
+    columns.template at<typename Table::s_quantity>(stock) = Field(nStock.s_quantity);
+    columns.template at<typename Table::s_ytd>(stock) = Field(nStock.s_ytd);
+    columns.template at<typename Table::s_order_cnt>(stock) = Field(nStock.s_order_cnt);
+    columns.template at<typename Table::s_remote_cnt>(stock) = Field(nStock.s_remote_cnt);
 }
 
-NewOrderResult Transactions::newOrderTransaction(tell::db::Transaction& tx, const NewOrderIn& in)
+// customer and customer_core both have what NewOrder returns
+template<class Table>
+void readCustomer(const Columns<Table>& columns, const Tuple& customer, NewOrderResult& result) {
+    result.c_last = columns.template get<typename Table::c_last>(customer);
+    result.c_credit = columns.template get<typename Table::c_credit>(customer);
+    result.c_discount = columns.template get<typename Table::c_discount>(customer);
+}
+
+}
+
+NewOrderResult Transactions::newOrderTransaction(tell::db::Transaction& tx, const NewOrderIn& in, ResultMode mode)
 {
     auto w_id = in.w_id;
     auto d_id = in.d_id;
     auto c_id = in.c_id;
     NewOrderResult result;
+    result.statusOnly = mode == ResultMode::STATUS_ONLY;
     try {
-        Random rnd;
+        auto o_ol_cnt = in.o_ol_cnt;
         int16_t o_all_local = 1;
-        int16_t o_ol_cnt = rnd->randomWithin<int16_t>(5, 15);
-        std::vector<int16_t> ol_supply_w_id(o_ol_cnt);
-        for (auto& i : ol_supply_w_id) {
-            i = w_id;
-            if (mNumWarehouses > 1 && rnd->randomWithin<int>(1, 100) == 1) {
+        for (int16_t i = 0; i < o_ol_cnt; ++i) {
+            if (in.lines[i].ol_supply_w_id != w_id) {
                 o_all_local = 0;
-                while (i == w_id) {
-                    i = rnd->randomWithin<int16_t>(1, mNumWarehouses);
-                }
             }
         }
         auto datetime = now();
-        auto wTableF = tx.openTable("warehouse");
-        auto cTableF = tx.openTable("customer");
-        auto dTableF = tx.openTable("district");
-        auto oTableF = tx.openTable("order");
-        auto noTableF = tx.openTable("new-order");
-        auto iTableF = tx.openTable("item");
-        auto olTableF = tx.openTable("order-line");
-        auto sTableF = tx.openTable("stock");
-        auto sTable = sTableF.get();
-        auto olTable = olTableF.get();
-        auto noTable = noTableF.get();
-        auto oTable = oTableF.get();
-        auto dTable = dTableF.get();
-        auto cTable = cTableF.get();
-        auto wTable = wTableF.get();
-        auto iTable = iTableF.get();
+        auto tables = mCatalog.tables(tx);
+        // with a split stock table only the counters get written, the texts
+        // come from stock_info
+        auto splitStock = tables->splitStock;
+        auto sTable = splitStock ? tables->stockCounters : tables->stock;
+        auto siTable = tables->stockInfo;
+        auto olTable = tables->orderLine;
+        auto noTable = tables->newOrder;
+        auto oTable = tables->order;
+        auto dTable = tables->district;
+        auto cTable = tables->customer;
+        auto wTable = tables->warehouse;
+        auto iTable = tables->item;
         WarehouseKey wKey(w_id);
         CustomerKey cKey(w_id, d_id, c_id);
         DistrictKey dKey(w_id, d_id);
-        auto warehouseF = tx.get(wTable, wKey.key());
-        auto customerF = tx.get(cTable, cKey.key());
-        auto districtF = tx.get(dTable, dKey.key());
+        // all reads only depend on the input, so they are all issued at once
+        CriticalPath path;
+        auto warehouseF = path.issue(tx.get(wTable, wKey.key()));
+        auto customerF = path.issue(tx.get(cTable, cKey.key()));
+        auto districtF = path.issue(tx.get(dTable, dKey.key()));
+        // get the items - unless they are cached
+        // get the stocks
+        auto cachedItems = mItems ? mItems->items() : nullptr;
+        FixedMap<ItemKey, CriticalPath::Request<Tuple>, MAX_ORDER_LINES> itemsF;
+        FixedMap<ItemKey, Tuple, MAX_ORDER_LINES> items;
+        FixedMap<StockKey, CriticalPath::Request<Tuple>, MAX_ORDER_LINES> stocksF;
+        FixedMap<StockKey, Tuple, MAX_ORDER_LINES> stocks;
+        FixedMap<StockKey, CriticalPath::Request<Tuple>, MAX_ORDER_LINES> stockInfosF;
+        FixedMap<StockKey, Tuple, MAX_ORDER_LINES> stockInfos;
+        bool validItems = true;
+        for (int16_t i = 0; i < o_ol_cnt; ++i) {
+            ItemKey iKey(in.lines[i].ol_i_id);
+            if (cachedItems) {
+                validItems = validItems && cachedItems->contains(iKey.i_id);
+            } else if (itemsF.count(iKey) == 0) {
+                itemsF.emplace(iKey, path.issue(tx.get(iTable, iKey.key())));
+            }
+            StockKey sKey(in.lines[i].ol_supply_w_id, in.lines[i].ol_i_id);
+            if (validItems && stocksF.count(sKey) == 0) {
+                stocksF.emplace(sKey, path.issue(tx.get(sTable, sKey.key())));
+                if (splitStock) {
+                    stockInfosF.emplace(sKey, path.issue(tx.get(siTable, sKey.key())));
+                }
+            }
+        }
+        // 1% of the orders refer to an unused item, this has to be found out
+        // before anything is written
+        for (auto& p : itemsF) {
+            try {
+                items.emplace(p.first, p.second.get());
+            } catch (TupleDoesNotExist&) {
+                validItems = false;
+            }
+        }
+        if (!validItems) {
+            tx.rollback();
+            result.success = false;
+            result.error = "Item number is not valid";
+            result.abortReason = AbortReason::ROLLBACK;
+            return result;
+        }
         auto district = districtF.get();
         auto customer = customerF.get();
         auto warehouse = warehouseF.get();
         auto districtNew = district;
-        auto d_next_o_id = district.at("d_next_o_id");
-        districtNew.at("d_next_o_id") += Field(int32_t(1));
+        auto d_next_o_id = tables->districtColumns.get<schema::District::d_next_o_id>(district);
+        tables->districtColumns.at<schema::District::d_next_o_id>(districtNew) += Field(int32_t(1));
         tx.update(dTable, dKey.key(), district, districtNew);
         // insert order
-        auto o_id = d_next_o_id.value<int32_t>();
+        auto o_id = d_next_o_id;
         OrderKey oKey(w_id, d_id, o_id);
         tx.insert(oTable, oKey.key(),
                 {{
@@ -110,65 +175,32 @@ NewOrderResult Transactions::newOrderTransaction(tell::db::Transaction& tx, cons
                 {"no_d_id", d_id},
                 {"no_w_id", w_id}
                 }});
-        // generate random items
-        std::vector<int32_t> ol_i_id;
-        ol_i_id.reserve(o_ol_cnt);
-        for (int16_t i = 0; i < o_ol_cnt; ++i) {
-            auto i_id = rnd->NURand<int32_t>(8191,1,100000);
-            ol_i_id.push_back(i_id);
-        }
-        // get the items
-        // get the stocks
-        std::unordered_map<ItemKey, Future<Tuple>> itemsF;
-        std::unordered_map<ItemKey, Tuple> items;
-        std::unordered_map<StockKey, Future<Tuple>> stocksF;
-        std::unordered_map<StockKey, Tuple> stocks;
-        itemsF.reserve(o_ol_cnt);
-        items.reserve(o_ol_cnt);
-        stocksF.reserve(o_ol_cnt);
-        stocks.reserve(o_ol_cnt);
-        for (int16_t i = 0; i < o_ol_cnt; ++i) {
-            auto i_id = ol_i_id[i];
-            ItemKey iKey(i_id);
-            if (itemsF.count(i_id) == 0) {
-                itemsF.emplace(iKey, tx.get(iTable, iKey.key()));
-            }
-            StockKey sKey(ol_supply_w_id[i], i_id);
-            if (stocksF.count(sKey) == 0) {
-                stocksF.emplace(sKey, tx.get(sTable, sKey.key()));
-            }
-        }
-        std::unordered_map<StockKey, NewStock> newStocks;
+        FixedMap<StockKey, NewStock, MAX_ORDER_LINES> newStocks;
         for (auto& p : stocksF) {
             auto stock = p.second.get();
-            NewStock nStock;
-            nStock.s_quantity = stock.at("s_quantity").value<int32_t>();
-            nStock.s_ytd = stock.at("s_ytd").value<int32_t>();
-            nStock.s_order_cnt = stock.at("s_order_cnt").value<int16_t>();
-            nStock.s_remote_cnt = stock.at("s_remote_cnt").value<int16_t>();
-            newStocks.emplace(p.first, std::move(nStock));
+            newStocks.emplace(p.first, splitStock ? readCounters(tables->stockCountersColumns, stock)
+                    : readCounters(tables->stockColumns, stock));
             stocks.emplace(p.first, std::move(stock));
         }
-        for (auto& p : itemsF) {
-            items.emplace(p.first, p.second.get());
-        }
-        // set ol_dist_info key
-        crossbow::string ol_dist_info_key;
-        if (d_id == 10) {
-            ol_dist_info_key ="s_dist_10";
-        } else {
-            ol_dist_info_key = "s_dist_0" + crossbow::to_string(d_id);
+        for (auto& p : stockInfosF) {
+            stockInfos.emplace(p.first, p.second.get());
         }
+        // s_dist_01 to s_dist_10 are declared next to each other
+        size_t ol_dist_info_offset = d_id - 1;
         int32_t ol_amount_sum = 0;
+        if (!result.statusOnly) {
+            result.lines.reserve(o_ol_cnt);
+        }
         // insert the order lines
         for (int16_t i = 0; i < o_ol_cnt; ++i) {
             int16_t ol_number = i + 1;
-            ItemKey itemId(ol_i_id[i]);
-            auto& item = items.at(itemId);
-            StockKey stockId(ol_supply_w_id[i], ol_i_id[i]);
-            auto& stock = stocks.at(stockId);
-            auto ol_dist_info = stock.at(ol_dist_info_key).value<crossbow::string>();
-            auto ol_quantity = rnd->randomWithin<int16_t>(1, 10);
+            const auto& line = in.lines[i];
+            StockKey stockId(line.ol_supply_w_id, line.ol_i_id);
+            const auto& stockInfo = splitStock ? stockInfos.at(stockId) : stocks.at(stockId);
+            auto ol_dist_info = splitStock
+                ? tables->stockInfoColumns.get<schema::StockInfo::s_dist_01>(stockInfo, ol_dist_info_offset)
+                : tables->stockColumns.get<schema::Stock::s_dist_01>(stockInfo, ol_dist_info_offset);
+            auto ol_quantity = line.ol_quantity;
             auto& newStock = newStocks.at(stockId);
             if (newStock.s_quantity > ol_quantity + 10) {
                 newStock.s_quantity -= ol_quantity;
@@ -177,8 +209,9 @@ NewOrderResult Transactions::newOrderTransaction(tell::db::Transaction& tx, cons
             }
             newStock.s_ytd += ol_quantity;
             ++newStock.s_order_cnt;
-            if (ol_supply_w_id[i] != w_id) ++newStock.s_remote_cnt;
-            auto i_price = item.at("i_price").value<int32_t>();
+            if (line.ol_supply_w_id != w_id) ++newStock.s_remote_cnt;
+            auto i_price = cachedItems ? cachedItems->price(line.ol_i_id)
+                : tables->itemColumns.get<schema::Item::i_price>(items.at(line.ol_i_id));
             int32_t ol_amount = i_price * int32_t(ol_quantity);
             ol_amount_sum += ol_amount;
             OrderlineKey olKey(w_id, d_id, o_id, ol_number);
@@ -188,26 +221,38 @@ NewOrderResult Transactions::newOrderTransaction(tell::db::Transaction& tx, cons
                     {"ol_d_id", d_id},
                     {"ol_w_id", w_id},
                     {"ol_number", ol_number},
-                    {"ol_i_id", ol_i_id[i]},
-                    {"ol_supply_w_id", ol_supply_w_id[i]},
+                    {"ol_i_id", line.ol_i_id},
+                    {"ol_supply_w_id", line.ol_supply_w_id},
                     {"ol_delivery_d", nullptr},
                     {"ol_quantity", ol_quantity},
                     {"ol_amount", ol_amount},
                     {"ol_dist_info", ol_dist_info}
                     }});
+            if (result.statusOnly) {
+                continue;
+            }
             // set Result for this order line
-            const auto& i_data = item.at("i_data").value<crossbow::string>();
-            const auto& s_data = stock.at("s_data").value<crossbow::string>();
+            bool i_original;
             NewOrderResult::OrderLine lineRes;
-            lineRes.ol_supply_w_id = ol_supply_w_id[i];
-            lineRes.ol_i_id = ol_i_id[i];
-            lineRes.i_name = item.at("i_name").value<crossbow::string>();
+            if (cachedItems) {
+                lineRes.i_name = cachedItems->name(line.ol_i_id);
+                i_original = cachedItems->original(line.ol_i_id);
+            } else {
+                auto& item = items.at(line.ol_i_id);
+                const auto& i_data = tables->itemColumns.get<schema::Item::i_data>(item);
+                lineRes.i_name = tables->itemColumns.get<schema::Item::i_name>(item);
+                i_original = i_data.find("ORIGINAL") != i_data.npos;
+            }
+            const auto& s_data = splitStock ? tables->stockInfoColumns.get<schema::StockInfo::s_data>(stockInfo)
+                : tables->stockColumns.get<schema::Stock::s_data>(stockInfo);
+            lineRes.ol_supply_w_id = line.ol_supply_w_id;
+            lineRes.ol_i_id = line.ol_i_id;
             lineRes.ol_quantity = ol_quantity;
             lineRes.s_quantity = newStock.s_quantity;
             lineRes.i_price = i_price;
             lineRes.ol_amount = ol_amount;
             lineRes.brand_generic = 'G';
-            if (i_data.find("ORIGINAL") != i_data.npos && s_data.find("ORIGINAL") != s_data.npos) {
+            if (i_original && s_data.find("ORIGINAL") != s_data.npos) {
                 lineRes.brand_generic = 'B';
             }
             result.lines.emplace_back(std::move(lineRes));
@@ -216,34 +261,33 @@ NewOrderResult Transactions::newOrderTransaction(tell::db::Transaction& tx, cons
         for (const auto& p : stocks) {
             const auto& nStock = newStocks.at(p.first);
             auto n = p.second;
-            n.at("s_quantity") = Field(nStock.s_quantity);
-            n.at("s_ytd") = Field(nStock.s_ytd);
-            n.at("s_order_cnt") = Field(nStock.s_order_cnt);
-            n.at("s_remote_cnt") = Field(nStock.s_remote_cnt);
+            if (splitStock) {
+                writeCounters(tables->stockCountersColumns, n, nStock);
+            } else {
+                writeCounters(tables->stockColumns, n, nStock);
+            }
             tx.update(sTable, p.first.key(), p.second, n);
         }
-        // 1% of transactions need to abort
-        if (rnd->randomWithin<int>(1, 100) == 1) {
-            tx.rollback();
-            result.success = false;
-            result.error = "Item number is not valid";
-            result.lines.clear();
-        } else {
-            // write single-line results
-            result.o_id = o_id;
+        // write single-line results
+        result.o_id = o_id;
+        if (!result.statusOnly) {
             result.o_ol_cnt = o_ol_cnt;
-            result.c_last = customer.at("c_last").value<crossbow::string>();
-            result.c_credit = customer.at("c_credit").value<crossbow::string>();
-            result.c_discount = customer.at("c_discount").value<int32_t>();
-            result.w_tax = warehouse.at("w_tax").value<int32_t>();
-            result.d_tax = district.at("d_tax").value<int32_t>();
+            if (tables->splitCustomer) {
+                readCustomer(tables->customerCoreColumns, customer, result);
+            } else {
+                readCustomer(tables->customerColumns, customer, result);
+            }
+            result.w_tax = tables->warehouseColumns.get<schema::Warehouse::w_tax>(warehouse);
+            result.d_tax = tables->districtColumns.get<schema::District::d_tax>(district);
             result.o_entry_d = datetime;
             result.total_amount = ol_amount_sum * (1 - result.c_discount) * (1 + result.w_tax + result.d_tax);
-            tx.commit();
         }
+        tx.commit();
+        mStatistics.recordCriticalPath(Command::NEW_ORDER, path.length());
     } catch (std::exception& ex) {
         result.success = false;
         result.error = ex.what();
+        result.abortReason = classifyAbort(ex);
         result.lines.clear();
     }
     return result;
@@ -24,6 +24,8 @@
 #include <telldb/Exceptions.hpp>
 #include <sstream>
 
+#include <boost/container/static_vector.hpp>
+
 using namespace tell::db;
 
 namespace tpcc {
@@ -31,52 +33,55 @@ namespace tpcc {
 OrderStatusResult Transactions::orderStatus(Transaction& tx, const OrderStatusIn& in) {
     OrderStatusResult result;
     try {
-        auto oTableF = tx.openTable("order");
-        auto olTableF = tx.openTable("order-line");
-        auto cTableF = tx.openTable("customer");
-        auto cTable = cTableF.get();
-        auto oTable = oTableF.get();
-        auto olTable = olTableF.get();
+        Arena arena;
+        auto tables = mCatalog.tables(tx);
+        auto oTable = tables->order;
+        auto olTable = tables->orderLine;
+        CriticalPath path;
         // get Customer
         CustomerKey cKey{0, 0, 0};
-        auto customerF = getCustomer(tx, in.selectByLastName, in.c_last, in.w_id, in.d_id, in.c_id, cTable, cKey);
+        auto customerF = getCustomer(tx, in.selectByLastName, in.c_last, in.w_id, in.d_id, in.c_id, *tables, arena,
+                path, cKey);
         // get newest order
-        auto iter = tx.reverse_lower_bound(oTable, "order_idx", {
+        auto iter = tx.reverse_lower_bound(oTable, tables->orderIdx, {
                 Field(in.w_id)
                 , Field(in.d_id)
                 , Field(cKey.c_id)
                 , Field(std::numeric_limits<int32_t>::max())
                 });
+        path.sync();
         if (iter.done()) {
             result.success = false;
             std::stringstream errstream;
             errstream << "Customer name=" << in.c_last << ", w_id=" << in.w_id << ", d_id=" << in.d_id << ", c_id="
                     << cKey.c_id << " does not exist";
             result.error = errstream.str();
+            result.abortReason = AbortReason::NOT_FOUND;
             return result;
         }
         OrderKey oKey{iter.value()};
-        auto orderF = tx.get(oTable, iter.value());
+        auto orderF = path.issue(tx.get(oTable, iter.value()));
         auto order = orderF.get();
         auto customer = customerF.get();
-        auto ol_cnt = order.at("o_ol_cnt").value<int16_t>();
+        auto ol_cnt = tables->orderColumns.get<schema::Order::o_ol_cnt>(order);
         // To get the order lines, we could use an index - but this is not necessary,
         // since we can generate all primary keys instead
         OrderlineKey olKey{in.w_id, in.d_id, oKey.o_id, int16_t(1)};
-        std::vector<Future<Tuple>> reqs;
-        reqs.reserve(ol_cnt);
+        boost::container::static_vector<CriticalPath::Request<Tuple>, MAX_ORDER_LINES> reqs;
         for (decltype(ol_cnt) i = 1; i <= ol_cnt; ++i) {
             olKey.ol_number = i;
-            reqs.emplace_back(tx.get(olTable, olKey.key()));
+            reqs.emplace_back(path.issue(tx.get(olTable, olKey.key())));
         }
         for (auto& f : reqs) {
             f.get();
         }
         tx.commit();
+        mStatistics.recordCriticalPath(Command::ORDER_STATUS, path.length());
         result.success = true;
     } catch (std::exception& ex) {
         result.success = false;
         result.error = ex.what();
+        result.abortReason = classifyAbort(ex);
     }
     return result;
 }
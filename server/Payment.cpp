@@ -27,24 +27,51 @@ using namespace tell::db;
 
 namespace tpcc {
 
+namespace {
 
-Future<Tuple> Transactions::getCustomer(Transaction& tx,
+// customer and customer_core both have the balance and the payment counters
+template<class Table>
+bool addPayment(const Columns<Table>& columns, Tuple& customer, int64_t amount) {
+    columns.template at<typename Table::c_balance>(customer) += Field(amount);
+    columns.template at<typename Table::c_ytd_payment>(customer) += Field(amount);
+    columns.template at<typename Table::c_payment_cnt>(customer) += Field(int16_t(1));
+    return columns.template get<typename Table::c_credit>(customer) == "BC";
+}
+
+// customer and customer_info both have c_data
+template<class Table>
+void prependData(const Columns<Table>& columns, Tuple& customer, const crossbow::string& histInfo) {
+    auto c_data = columns.template get<typename Table::c_data>(customer);
+    c_data.insert(0, histInfo);
+    if (c_data.size() > 500) {
+        c_data.resize(500);
+    }
+    columns.template at<typename Table::c_data>(customer) = c_data;
+}
+
+} // anonymous namespace
+
+CriticalPath::Request<Tuple> Transactions::getCustomer(Transaction& tx,
         bool selectByLastName,
         const crossbow::string& c_last,
         int16_t c_w_id,
         int16_t c_d_id,
         int32_t c_id,
-        table_t customerTable,
+        const Tables& tables,
+        Arena& arena,
+        CriticalPath& path,
         CustomerKey& customerKey) {
     if (selectByLastName) {
-        auto iter = tx.lower_bound(customerTable, "c_last_idx",
+        auto iter = tx.lower_bound(tables.customer, tables.customerLastNameIdx,
                 std::vector<Field>({
                     Field(c_w_id)
                     , Field(c_d_id)
                     , Field(c_last)
                     , Field("")
                     }));
-        std::vector<tell::db::key_t> keys;
+        path.sync();
+        ArenaVector<tell::db::key_t> keys(arena);
+        keys.reserve(8);
         for (; !iter.done(); iter.next()) {
             auto k = iter.key();
             if (k[2].value<crossbow::string>() != c_last) {
@@ -55,7 +82,7 @@ Future<Tuple> Transactions::getCustomer(Transaction& tx,
         if (keys.empty()) {
             crossbow::string msg = "No customer found for name ";
             msg.append(c_last);
-            throw std::runtime_error(msg.c_str());
+            throw NotFound(msg.c_str());
         }
         auto pos = keys.size();
         pos = pos % 2 == 0 ? (pos / 2) : (pos / 2 + 1);
@@ -63,68 +90,69 @@ Future<Tuple> Transactions::getCustomer(Transaction& tx,
     } else {
         customerKey = CustomerKey{c_w_id, c_d_id, c_id};
     }
-    return tx.get(customerTable, customerKey.key());
+    return path.issue(tx.get(tables.customer, customerKey.key()));
 }
 
 PaymentResult Transactions::payment(tell::db::Transaction& tx, const PaymentIn& in) {
     PaymentResult result;
     try {
-        auto cTableF = tx.openTable("customer");
-        auto wTableF = tx.openTable("warehouse");
-        auto dTableF = tx.openTable("district");
-        auto hTableF = tx.openTable("history");
-        auto hTable = hTableF.get();
-        auto dTable = dTableF.get();
-        auto wTable = wTableF.get();
-        auto cTable = cTableF.get();
-        CustomerKey customerKey(0, 0, 0);
-        auto customerF = getCustomer(tx, in.selectByLastName, in.c_last,
-               in.c_w_id, in.c_d_id, in.c_id, cTable, customerKey);
+        Arena arena;
+        auto tables = mCatalog.tables(tx);
+        auto hTable = tables->history;
+        auto dTable = tables->district;
+        auto wTable = tables->warehouse;
+        auto cTable = tables->customer;
+        CriticalPath path;
+        // warehouse and district are in flight while the customer gets looked up
         DistrictKey dKey{in.w_id, in.d_id};
-        auto districtF = tx.get(dTable, dKey.key());
+        auto districtF = path.issue(tx.get(dTable, dKey.key()));
         tell::db::key_t warehouseKey{uint64_t(in.w_id)};
-        auto warehouseF = tx.get(wTable, warehouseKey);
+        auto warehouseF = path.issue(tx.get(wTable, warehouseKey));
+        CustomerKey customerKey(0, 0, 0);
+        auto customerF = getCustomer(tx, in.selectByLastName, in.c_last,
+               in.c_w_id, in.c_d_id, in.c_id, *tables, arena, path, customerKey);
         auto warehouse = warehouseF.get();
         auto nWarehouse = warehouse;
         // update the warehouses ytd
         {
-            auto value = warehouse.at("w_ytd").value<int64_t>();
-            nWarehouse.at("w_ytd") = Field(int64_t(value + in.h_amount));
+            auto value = tables->warehouseColumns.get<schema::Warehouse::w_ytd>(warehouse);
+            tables->warehouseColumns.at<schema::Warehouse::w_ytd>(nWarehouse) = Field(int64_t(value + in.h_amount));
         }
         tx.update(wTable, warehouseKey, warehouse, nWarehouse);
         auto district = districtF.get();
         auto nDistrict = district;
         {
-            auto value = district.at("d_ytd").value<int64_t>();
-            nDistrict.at("d_ytd") = Field(int64_t(value + in.h_amount));
+            auto value = tables->districtColumns.get<schema::District::d_ytd>(district);
+            tables->districtColumns.at<schema::District::d_ytd>(nDistrict) = Field(int64_t(value + in.h_amount));
         }
         tx.update(dTable, dKey.key(), district, nDistrict);
         auto customer = customerF.get();
         auto nCustomer = customer;
-        {
-            nCustomer.at("c_balance") += Field(int64_t(in.h_amount));
-            nCustomer.at("c_ytd_payment") += Field(int64_t(in.h_amount));
-            nCustomer.at("c_payment_cnt") += Field(int16_t(in.h_amount));
-            if (customer.at("c_credit").value<crossbow::string>() == "BC") {
-                crossbow::string histInfo = "(" + crossbow::to_string(customerKey.c_id) +
-                    "," + crossbow::to_string(customerKey.d_id) + "," + crossbow::to_string(customerKey.w_id) +
-                    "," + crossbow::to_string(in.d_id) + "," + crossbow::to_string(in.w_id) +
-                    "," + crossbow::to_string(in.h_amount);
-                auto c_data = nCustomer.at("c_data").value<crossbow::string>();
-                c_data.insert(0, histInfo);
-                if (c_data.size() > 500) {
-                    c_data.resize(500);
-                }
-                nCustomer.at("c_data") = c_data;
+        auto badCredit = tables->splitCustomer
+            ? addPayment(tables->customerCoreColumns, nCustomer, in.h_amount)
+            : addPayment(tables->customerColumns, nCustomer, in.h_amount);
+        if (badCredit) {
+            crossbow::string histInfo = "(" + crossbow::to_string(customerKey.c_id) +
+                "," + crossbow::to_string(customerKey.d_id) + "," + crossbow::to_string(customerKey.w_id) +
+                "," + crossbow::to_string(in.d_id) + "," + crossbow::to_string(in.w_id) +
+                "," + crossbow::to_string(in.h_amount);
+            if (tables->splitCustomer) {
+                // only BC customers need customer_info, so it is not read up front
+                auto infoF = path.issue(tx.get(tables->customerInfo, customerKey.key()));
+                auto info = infoF.get();
+                auto nInfo = info;
+                prependData(tables->customerInfoColumns, nInfo, histInfo);
+                tx.update(tables->customerInfo, customerKey.key(), info, nInfo);
+            } else {
+                prependData(tables->customerColumns, nCustomer, histInfo);
             }
         }
         tx.update(cTable, customerKey.key(), customer, nCustomer);
         // insert into history
-        crossbow::string h_data = warehouse.at("w_name").value<crossbow::string>()
-            + district.at("d_name").value<crossbow::string>();
+        crossbow::string h_data = tables->warehouseColumns.get<schema::Warehouse::w_name>(warehouse)
+            + tables->districtColumns.get<schema::District::d_name>(district);
 
-        auto counter = tx.getCounter("history_counter");
-        tell::db::key_t historyKey{counter.next()};
+        tell::db::key_t historyKey{mHistoryIds.next(tx, tables->generation)};
 
         tx.insert(hTable, historyKey,
                 {{
@@ -138,10 +166,12 @@ PaymentResult Transactions::payment(tell::db::Transaction& tx, const PaymentIn&
                 {"h_data", h_data}
                 }});
         tx.commit();
+        mStatistics.recordCriticalPath(Command::PAYMENT, path.length());
         result.success = true;
     } catch (std::exception& ex) {
         result.success = false;
         result.error = ex.what();
+        result.abortReason = classifyAbort(ex);
     }
     return result;
 }
@@ -41,7 +41,7 @@ void Populator::populateDimTables(Transaction &transaction, bool useCH)
 }
 
 void Populator::populateWarehouse(tell::db::Transaction &transaction,
-                                  Counter &counter, int16_t w_id, bool useCH) {
+                                  HistoryIds &historyIds, int16_t w_id, bool useCH) {
     auto tIdFuture = transaction.openTable("warehouse");
     auto table = tIdFuture.get();
     tell::db::key_t key{uint64_t(w_id)};
@@ -56,7 +56,7 @@ void Populator::populateWarehouse(tell::db::Transaction &transaction,
                          {"w_tax", mRandom.random<int32_t>(0, 2000)},
                          {"w_ytd", int64_t(30000000)}}});
     populateStocks(transaction, w_id, useCH);
-    populateDistricts(transaction, counter, w_id, useCH);
+    populateDistricts(transaction, historyIds, w_id, useCH);
 }
 
 void Populator::populateItems(tell::db::Transaction &transaction) {
@@ -148,8 +148,16 @@ void Populator::populateSuppliers(Transaction &transaction)
 
 void Populator::populateStocks(tell::db::Transaction &transaction,
                                int16_t w_id, bool useCH) {
-    auto tIdFuture   = transaction.openTable("stock");
-    auto table       = tIdFuture.get();
+    tell::db::table_t table;
+    tell::db::table_t infoTable;
+    if (mLayout.splitStock) {
+        auto tIdFuture = transaction.openTable("stock_counters");
+        auto infoFuture = transaction.openTable("stock_info");
+        table = tIdFuture.get();
+        infoTable = infoFuture.get();
+    } else {
+        table = transaction.openTable("stock").get();
+    }
     uint64_t keyBase = uint64_t(w_id);
     keyBase = keyBase << 32;
     for (int32_t s_i_id = 1; s_i_id <= 100000; ++s_i_id) {
@@ -185,13 +193,26 @@ void Populator::populateStocks(tell::db::Transaction &transaction,
         if (useCH)
             tuple.emplace("s_su_suppkey", int16_t(mRandom.randomWithin(1,10000)));
 
-        transaction.insert(
-          table, key, tuple);
+        if (!mLayout.splitStock) {
+            transaction.insert(
+              table, key, tuple);
+            continue;
+        }
+        // stock_info gets everything but the counters
+        std::unordered_map<crossbow::string, Field> counters =
+        {{{"s_i_id", s_i_id},
+        {"s_w_id", w_id}}};
+        for (auto name : {"s_quantity", "s_ytd", "s_order_cnt", "s_remote_cnt"}) {
+            counters.emplace(name, tuple.at(name));
+            tuple.erase(name);
+        }
+        transaction.insert(table, key, counters);
+        transaction.insert(infoTable, key, tuple);
     }
 }
 
 void Populator::populateDistricts(tell::db::Transaction &transaction,
-                                  Counter &counter, int16_t w_id, bool useCH) {
+                                  HistoryIds &historyIds, int16_t w_id, bool useCH) {
     auto tIdFuture   = transaction.openTable("district");
     auto table       = tIdFuture.get();
     uint64_t keyBase = w_id;
@@ -211,17 +232,25 @@ void Populator::populateDistricts(tell::db::Transaction &transaction,
                              {"d_tax", int(mRandom.randomWithin(0, 2000))},
                              {"d_ytd", int64_t(3000000)},
                              {"d_next_o_id", int(3001)}}});
-        populateCustomers(transaction, counter, w_id, i, n, useCH);
+        populateCustomers(transaction, historyIds, w_id, i, n, useCH);
         populateOrders(transaction, i, w_id, n);
         populateNewOrders(transaction, w_id, i);
     }
 }
 
 void Populator::populateCustomers(tell::db::Transaction &transaction,
-                                  Counter &counter, int16_t w_id, int16_t d_id,
+                                  HistoryIds &historyIds, int16_t w_id, int16_t d_id,
                                   int64_t c_since, bool useCH) {
-    auto tIdFuture   = transaction.openTable("customer");
-    auto table       = tIdFuture.get();
+    tell::db::table_t table;
+    tell::db::table_t infoTable;
+    if (mLayout.splitCustomer) {
+        auto tIdFuture = transaction.openTable("customer_core");
+        auto infoFuture = transaction.openTable("customer_info");
+        table = tIdFuture.get();
+        infoTable = infoFuture.get();
+    } else {
+        table = transaction.openTable("customer").get();
+    }
     uint64_t keyBase = uint64_t(w_id) << (5 * 8);
     keyBase |= (uint64_t(d_id) << 4 * 8);
     for (int32_t c_id = 1; c_id <= 3000; ++c_id) {
@@ -260,16 +289,28 @@ void Populator::populateCustomers(tell::db::Transaction &transaction,
         if (useCH)
             tuple.emplace("c_n_nationkey", int16_t(mRandom.randomWithin(0,24)));
 
+        if (mLayout.splitCustomer) {
+            // customer_core gets everything but the address and c_data
+            std::unordered_map<crossbow::string, Field> info =
+            {{{"c_id", c_id},
+            {"c_d_id", d_id},
+            {"c_w_id", w_id}}};
+            for (auto name : {"c_street_1", "c_street_2", "c_city", "c_state", "c_zip", "c_phone", "c_data"}) {
+                info.emplace(name, tuple.at(name));
+                tuple.erase(name);
+            }
+            transaction.insert(infoTable, tell::db::key_t{key}, info);
+        }
         transaction.insert(
           table, tell::db::key_t{key}, tuple);
-        populateHistory(transaction, counter, c_id, d_id, w_id, c_since);
+        populateHistory(transaction, historyIds, c_id, d_id, w_id, c_since);
     }
 }
 
 void Populator::populateHistory(tell::db::Transaction &transaction,
-                                tell::db::Counter &counter, int32_t c_id,
+                                HistoryIds &historyIds, int32_t c_id,
                                 int16_t d_id, int16_t w_id, int64_t n) {
-    uint64_t key   = counter.next();
+    uint64_t key   = historyIds.next(transaction);
     auto tIdFuture = transaction.openTable("history");
     auto table = tIdFuture.get();
     transaction.insert(table, tell::db::key_t{key},
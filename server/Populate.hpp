@@ -26,11 +26,13 @@
 #include <crossbow/string.hpp>
 #include <common/Util.hpp>
 
+#include "HistoryIds.hpp"
+#include "CreateSchema.hpp"
+
 namespace tell {
 namespace db {
 
 class Transaction;
-class Counter;
 
 } // namespace db
 } // namespace tell
@@ -40,19 +42,21 @@ namespace tpcc {
 class Populator {
     Random_t& mRandom;
     crossbow::string mOriginal = "ORIGINAL";
+    SchemaLayout mLayout;
 public:
     Populator() : mRandom(*Random()) {}
+    explicit Populator(const SchemaLayout& layout) : mRandom(*Random()), mLayout(layout) {}
     void populateDimTables(tell::db::Transaction& transaction, bool useCH);
-    void populateWarehouse(tell::db::Transaction& transaction, tell::db::Counter& counter, int16_t w_id, bool useCH);
+    void populateWarehouse(tell::db::Transaction& transaction, HistoryIds& historyIds, int16_t w_id, bool useCH);
 private:
     void populateItems(tell::db::Transaction& transaction);
     void populateRegions(tell::db::Transaction& transaction);
     void populateNations(tell::db::Transaction& transaction);
     void populateSuppliers(tell::db::Transaction &transaction);
     void populateStocks(tell::db::Transaction& transaction, int16_t w_id, bool useCH);
-    void populateDistricts(tell::db::Transaction& transaction, tell::db::Counter& counter, int16_t w_id, bool useCH);
-    void populateCustomers(tell::db::Transaction& transaction, tell::db::Counter& counter, int16_t w_id, int16_t d_id, int64_t c_since, bool useCH);
-    void populateHistory(tell::db::Transaction& transaction, tell::db::Counter& counter, int32_t c_id, int16_t d_id, int16_t w_id, int64_t n);
+    void populateDistricts(tell::db::Transaction& transaction, HistoryIds& historyIds, int16_t w_id, bool useCH);
+    void populateCustomers(tell::db::Transaction& transaction, HistoryIds& historyIds, int16_t w_id, int16_t d_id, int64_t c_since, bool useCH);
+    void populateHistory(tell::db::Transaction& transaction, HistoryIds& historyIds, int32_t c_id, int16_t d_id, int16_t w_id, int64_t n);
     void populateOrders(tell::db::Transaction& transaction, int16_t d_id, int16_t w_id, int64_t o_entry_d);
     void populateOrderLines(tell::db::Transaction& transaction,
             int32_t o_id, int16_t d_id, int16_t w_id, int16_t ol_cnt, int64_t o_entry_d);
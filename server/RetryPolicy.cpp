@@ -0,0 +1,72 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "RetryPolicy.hpp"
+#include "Transactions.hpp"
+
+#include <telldb/Exceptions.hpp>
+
+#include <boost/system/system_error.hpp>
+
+#include <algorithm>
+#include <random>
+#include <system_error>
+
+namespace tpcc {
+
+AbortReason classifyAbort(const std::exception& ex) {
+    if (dynamic_cast<const tell::db::Conflict*>(&ex)) {
+        return AbortReason::CONFLICT;
+    }
+    if (dynamic_cast<const tell::db::TupleDoesNotExist*>(&ex) || dynamic_cast<const NotFound*>(&ex)) {
+        return AbortReason::NOT_FOUND;
+    }
+    if (auto err = dynamic_cast<const boost::system::system_error*>(&ex)) {
+        if (err->code() == boost::system::errc::timed_out) {
+            return AbortReason::TIMEOUT;
+        }
+    }
+    if (auto err = dynamic_cast<const std::system_error*>(&ex)) {
+        if (err->code() == std::errc::timed_out) {
+            return AbortReason::TIMEOUT;
+        }
+    }
+    return AbortReason::OTHER;
+}
+
+bool RetryPolicy::retry(AbortReason reason, unsigned attempts) const {
+    if (attempts >= mMaxAttempts) {
+        return false;
+    }
+    return reason == AbortReason::CONFLICT || reason == AbortReason::TIMEOUT;
+}
+
+std::chrono::microseconds RetryPolicy::backoff(unsigned attempts) const {
+    // the random generator of Util.hpp is shared by all threads
+    static thread_local std::minstd_rand rnd(std::random_device{}());
+    auto limit = mBackoff.count() << std::min(attempts - 1, 20u);
+    limit = std::min(limit, decltype(limit)(mMaxBackoff.count()));
+    std::uniform_int_distribution<decltype(limit)> dist(0, limit);
+    return std::chrono::microseconds(dist(rnd));
+}
+
+} // namespace tpcc
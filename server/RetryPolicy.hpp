@@ -0,0 +1,67 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <chrono>
+#include <exception>
+
+#include <common/Protocol.hpp>
+
+namespace tpcc {
+
+/**
+ * Maps the exception a transaction aborted with to the reason reported to the
+ * client.
+ */
+AbortReason classifyAbort(const std::exception& ex);
+
+/**
+ * Decides whether the server runs an aborted transaction again and how long it
+ * waits before.
+ *
+ * Only transient aborts (conflicts and timeouts) get retried. The backoff
+ * doubles with every attempt and is jittered over the whole interval, so
+ * transactions which conflicted with each other do not collide again.
+ */
+class RetryPolicy {
+    unsigned mMaxAttempts;
+    std::chrono::microseconds mBackoff;
+    std::chrono::microseconds mMaxBackoff;
+public:
+    /**
+     * maxAttempts includes the first execution, 1 disables retries
+     */
+    RetryPolicy(unsigned maxAttempts, std::chrono::microseconds backoff, std::chrono::microseconds maxBackoff)
+        : mMaxAttempts(maxAttempts)
+        , mBackoff(backoff)
+        , mMaxBackoff(maxBackoff)
+    {}
+
+    bool retry(AbortReason reason, unsigned attempts) const;
+
+    /**
+     * How long to wait before attempt number attempts + 1
+     */
+    std::chrono::microseconds backoff(unsigned attempts) const;
+};
+
+} // namespace tpcc
@@ -0,0 +1,339 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include <boost/preprocessor.hpp>
+
+#include <crossbow/string.hpp>
+#include <telldb/Transaction.hpp>
+
+/*
+ * Every table is defined exactly once as a sequence of columns
+ * (name, field type, not null, CH only). GEN_TABLE turns this into a struct
+ * with one nested type per column - carrying its C++ type and its position -
+ * and a function adding the fields to a tell schema.
+ */
+#define FIELD_TYPE_SMALLINT int16_t
+#define FIELD_TYPE_INT int32_t
+#define FIELD_TYPE_BIGINT int64_t
+#define FIELD_TYPE_DOUBLE double
+#define FIELD_TYPE_TEXT crossbow::string
+
+#define COLUMN_NAME(col) BOOST_PP_TUPLE_ELEM(4, 0, col)
+#define COLUMN_TYPE(col) BOOST_PP_TUPLE_ELEM(4, 1, col)
+#define COLUMN_NOT_NULL(col) BOOST_PP_TUPLE_ELEM(4, 2, col)
+#define COLUMN_CH_ONLY(col) BOOST_PP_TUPLE_ELEM(4, 3, col)
+
+#define GEN_COLUMN(r, data, i, col) \
+    struct COLUMN_NAME(col) { \
+        using type = BOOST_PP_CAT(FIELD_TYPE_, COLUMN_TYPE(col)); \
+        static constexpr size_t index = i; \
+    };
+
+#define GEN_COLUMN_NAME(r, data, col) BOOST_PP_STRINGIZE(COLUMN_NAME(col)),
+
+#define GEN_COLUMN_CH_ONLY(r, data, col) COLUMN_CH_ONLY(col),
+
+#define GEN_ADD_FIELD(r, data, col) \
+    if (!COLUMN_CH_ONLY(col) || useCH) { \
+        schema.addField(tell::store::FieldType::COLUMN_TYPE(col), BOOST_PP_STRINGIZE(COLUMN_NAME(col)), \
+                COLUMN_NOT_NULL(col)); \
+    }
+
+#define GEN_TABLE(Name, tableName, columns) \
+    struct Name { \
+        BOOST_PP_SEQ_FOR_EACH_I(GEN_COLUMN, _, columns) \
+        static constexpr size_t NUM_COLUMNS = BOOST_PP_SEQ_SIZE(columns); \
+        static const char* name() { \
+            return tableName; \
+        } \
+        static const char* columnName(size_t i) { \
+            static const char* names[] = { BOOST_PP_SEQ_FOR_EACH(GEN_COLUMN_NAME, _, columns) }; \
+            return names[i]; \
+        } \
+        static bool chOnly(size_t i) { \
+            static const bool chOnly[] = { BOOST_PP_SEQ_FOR_EACH(GEN_COLUMN_CH_ONLY, _, columns) }; \
+            return chOnly[i]; \
+        } \
+        static void addFields(tell::store::Schema& schema, bool useCH) { \
+            BOOST_PP_SEQ_FOR_EACH(GEN_ADD_FIELD, _, columns) \
+        } \
+    };
+
+namespace tpcc {
+namespace schema {
+
+GEN_TABLE(Warehouse, "warehouse",
+    ((w_id, SMALLINT, true, false))
+    ((w_name, TEXT, true, false))
+    ((w_street_1, TEXT, true, false))
+    ((w_street_2, TEXT, true, false))
+    ((w_city, TEXT, true, false))
+    ((w_state, TEXT, true, false))
+    ((w_zip, TEXT, true, false))
+    ((w_tax, INT, true, false))             // numeric (4,4)
+    ((w_ytd, BIGINT, true, false))          // numeric (12,2)
+)
+
+GEN_TABLE(District, "district",
+    ((d_id, SMALLINT, true, false))
+    ((d_w_id, SMALLINT, true, false))
+    ((d_name, TEXT, true, false))
+    ((d_street_1, TEXT, true, false))
+    ((d_street_2, TEXT, true, false))
+    ((d_city, TEXT, true, false))
+    ((d_state, TEXT, true, false))
+    ((d_zip, TEXT, true, false))
+    ((d_tax, INT, true, false))             // numeric (4,4)
+    ((d_ytd, BIGINT, true, false))          // numeric (12,2)
+    ((d_next_o_id, INT, true, false))
+)
+
+GEN_TABLE(Customer, "customer",
+    ((c_id, INT, true, false))
+    ((c_d_id, SMALLINT, true, false))
+    ((c_w_id, SMALLINT, true, false))
+    ((c_first, TEXT, true, false))
+    ((c_middle, TEXT, true, false))
+    ((c_last, TEXT, true, false))
+    ((c_street_1, TEXT, true, false))
+    ((c_street_2, TEXT, true, false))
+    ((c_city, TEXT, true, false))
+    ((c_state, TEXT, true, false))
+    ((c_zip, TEXT, true, false))
+    ((c_phone, TEXT, true, false))
+    ((c_since, BIGINT, true, false))
+    ((c_credit, TEXT, true, false))
+    ((c_credit_lim, BIGINT, true, false))   // numeric (12,2)
+    ((c_discount, INT, true, false))        // numeric (4,4)
+    ((c_balance, BIGINT, true, false))      // numeric (12,2)
+    ((c_ytd_payment, BIGINT, true, false))  // numeric (12,2)
+    ((c_payment_cnt, SMALLINT, true, false))
+    ((c_delivery_cnt, SMALLINT, true, false))
+    ((c_data, TEXT, true, false))
+    ((c_n_nationkey, SMALLINT, true, true))
+)
+
+// With a split customer table (see SchemaLayout) Payment and Delivery only
+// rewrite customer_core, customer_info is read and written for BC customers
+GEN_TABLE(CustomerCore, "customer_core",
+    ((c_id, INT, true, false))
+    ((c_d_id, SMALLINT, true, false))
+    ((c_w_id, SMALLINT, true, false))
+    ((c_first, TEXT, true, false))
+    ((c_middle, TEXT, true, false))
+    ((c_last, TEXT, true, false))
+    ((c_since, BIGINT, true, false))
+    ((c_credit, TEXT, true, false))
+    ((c_credit_lim, BIGINT, true, false))   // numeric (12,2)
+    ((c_discount, INT, true, false))        // numeric (4,4)
+    ((c_balance, BIGINT, true, false))      // numeric (12,2)
+    ((c_ytd_payment, BIGINT, true, false))  // numeric (12,2)
+    ((c_payment_cnt, SMALLINT, true, false))
+    ((c_delivery_cnt, SMALLINT, true, false))
+    ((c_n_nationkey, SMALLINT, true, true))
+)
+
+GEN_TABLE(CustomerInfo, "customer_info",
+    ((c_id, INT, true, false))
+    ((c_d_id, SMALLINT, true, false))
+    ((c_w_id, SMALLINT, true, false))
+    ((c_street_1, TEXT, true, false))
+    ((c_street_2, TEXT, true, false))
+    ((c_city, TEXT, true, false))
+    ((c_state, TEXT, true, false))
+    ((c_zip, TEXT, true, false))
+    ((c_phone, TEXT, true, false))
+    ((c_data, TEXT, true, false))
+)
+
+GEN_TABLE(History, "history",
+    ((h_c_id, INT, true, false))
+    ((h_c_d_id, SMALLINT, true, false))
+    ((h_c_w_id, SMALLINT, true, false))
+    ((h_d_id, SMALLINT, true, false))
+    ((h_w_id, SMALLINT, true, false))
+    ((h_date, BIGINT, true, false))         // datetime (nanosecs since 1970)
+    ((h_amount, INT, true, false))          // numeric (6,2)
+    ((h_data, TEXT, true, false))
+)
+
+GEN_TABLE(NewOrder, "new-order",
+    ((no_o_id, INT, true, false))
+    ((no_d_id, SMALLINT, true, false))
+    ((no_w_id, SMALLINT, true, false))
+)
+
+GEN_TABLE(Order, "order",
+    ((o_id, INT, true, false))
+    ((o_d_id, SMALLINT, true, false))
+    ((o_w_id, SMALLINT, true, false))
+    ((o_c_id, INT, true, false))
+    ((o_entry_d, BIGINT, true, false))      // datetime (nanosecs since 1970)
+    ((o_carrier_id, SMALLINT, false, false))
+    ((o_ol_cnt, SMALLINT, true, false))
+    ((o_all_local, SMALLINT, true, false))
+)
+
+GEN_TABLE(OrderLine, "order-line",
+    ((ol_o_id, INT, true, false))
+    ((ol_d_id, SMALLINT, true, false))
+    ((ol_w_id, SMALLINT, true, false))
+    ((ol_number, SMALLINT, true, false))
+    ((ol_i_id, INT, true, false))
+    ((ol_supply_w_id, SMALLINT, true, false))
+    ((ol_delivery_d, BIGINT, false, false)) // datetime (nanosecs since 1970)
+    ((ol_quantity, SMALLINT, true, false))
+    ((ol_amount, INT, true, false))         // numeric (6,2)
+    ((ol_dist_info, TEXT, true, false))
+)
+
+GEN_TABLE(Item, "item",
+    ((i_id, INT, true, false))
+    ((i_im_id, INT, true, false))
+    ((i_name, TEXT, true, false))
+    ((i_price, INT, true, false))           // numeric (5,2)
+    ((i_data, TEXT, true, false))
+)
+
+GEN_TABLE(Stock, "stock",
+    ((s_i_id, INT, true, false))
+    ((s_w_id, SMALLINT, true, false))
+    ((s_quantity, INT, true, false))
+    ((s_dist_01, TEXT, true, false))
+    ((s_dist_02, TEXT, true, false))
+    ((s_dist_03, TEXT, true, false))
+    ((s_dist_04, TEXT, true, false))
+    ((s_dist_05, TEXT, true, false))
+    ((s_dist_06, TEXT, true, false))
+    ((s_dist_07, TEXT, true, false))
+    ((s_dist_08, TEXT, true, false))
+    ((s_dist_09, TEXT, true, false))
+    ((s_dist_10, TEXT, true, false))
+    ((s_ytd, INT, true, false))
+    ((s_order_cnt, SMALLINT, true, false))
+    ((s_remote_cnt, SMALLINT, true, false))
+    ((s_data, TEXT, true, false))
+    ((s_su_suppkey, SMALLINT, true, true))
+)
+
+// With a split stock table (see SchemaLayout) NewOrder only rewrites the
+// counters, the texts are never written after population
+GEN_TABLE(StockCounters, "stock_counters",
+    ((s_i_id, INT, true, false))
+    ((s_w_id, SMALLINT, true, false))
+    ((s_quantity, INT, true, false))
+    ((s_ytd, INT, true, false))
+    ((s_order_cnt, SMALLINT, true, false))
+    ((s_remote_cnt, SMALLINT, true, false))
+)
+
+GEN_TABLE(StockInfo, "stock_info",
+    ((s_i_id, INT, true, false))
+    ((s_w_id, SMALLINT, true, false))
+    ((s_dist_01, TEXT, true, false))
+    ((s_dist_02, TEXT, true, false))
+    ((s_dist_03, TEXT, true, false))
+    ((s_dist_04, TEXT, true, false))
+    ((s_dist_05, TEXT, true, false))
+    ((s_dist_06, TEXT, true, false))
+    ((s_dist_07, TEXT, true, false))
+    ((s_dist_08, TEXT, true, false))
+    ((s_dist_09, TEXT, true, false))
+    ((s_dist_10, TEXT, true, false))
+    ((s_data, TEXT, true, false))
+    ((s_su_suppkey, SMALLINT, true, true))
+)
+
+GEN_TABLE(Region, "region",
+    ((r_regionkey, SMALLINT, true, false))
+    ((r_name, TEXT, true, false))
+    ((r_comment, TEXT, true, false))
+)
+
+GEN_TABLE(Nation, "nation",
+    ((n_nationkey, SMALLINT, true, false))
+    ((n_name, TEXT, true, false))
+    ((n_regionkey, SMALLINT, true, false))
+    ((n_comment, TEXT, true, false))
+)
+
+GEN_TABLE(Supplier, "supplier",
+    ((su_suppkey, SMALLINT, true, false))
+    ((su_name, TEXT, true, false))
+    ((su_address, TEXT, true, false))
+    ((su_nationkey, SMALLINT, true, false))
+    ((su_phone, TEXT, true, false))
+    ((su_acctbal, BIGINT, true, false))     // numeric (12,2)
+    ((su_comment, TEXT, true, false))
+)
+
+} // namespace schema
+
+/**
+ * Typed, indexed access to the fields of the tuples of one table.
+ *
+ * Tell assigns the field ids itself (and they depend on whether the CH
+ * columns exist), so they get looked up by name once, from the first tuple
+ * which is accessed - every access after that is an array lookup. The CH only
+ * columns are not resolved, the transactions never touch them.
+ */
+template<class Table>
+class Columns {
+    using id_t = tell::store::Schema::id_t;
+    mutable std::once_flag mResolved;
+    mutable std::array<id_t, Table::NUM_COLUMNS> mIds;
+public:
+    /**
+     * Reads column C - offset selects a column of the same type declared
+     * offset positions after C (like s_dist_xx).
+     */
+    template<class C>
+    auto get(const tell::db::Tuple& tuple, size_t offset = 0) const
+        -> decltype(tuple[id_t()].template value<typename C::type>()) {
+        return tuple[id(tuple, C::index + offset)].template value<typename C::type>();
+    }
+
+    template<class C>
+    tell::db::Field& at(tell::db::Tuple& tuple) const {
+        return tuple[id(tuple, C::index)];
+    }
+
+private:
+    id_t id(const tell::db::Tuple& tuple, size_t index) const {
+        std::call_once(mResolved, [this, &tuple]() {
+            for (size_t i = 0; i < Table::NUM_COLUMNS; ++i) {
+                if (!Table::chOnly(i)) {
+                    mIds[i] = tuple.idOf(Table::columnName(i));
+                }
+            }
+        });
+        return mIds[index];
+    }
+};
+
+} // namespace tpcc
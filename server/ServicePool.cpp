@@ -0,0 +1,68 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "ServicePool.hpp"
+
+#include <thread>
+
+namespace tpcc {
+
+ServicePool::ServicePool(unsigned numThreads) {
+    if (numThreads == 0) {
+        numThreads = 1;
+    }
+    mServices.reserve(numThreads);
+    mWork.reserve(numThreads);
+    for (unsigned i = 0; i < numThreads; ++i) {
+        mServices.emplace_back(new boost::asio::io_service(1));
+        mWork.emplace_back(new boost::asio::io_service::work(*mServices.back()));
+    }
+}
+
+boost::asio::io_service& ServicePool::next() {
+    auto& service = *mServices[mNext];
+    mNext = (mNext + 1) % mServices.size();
+    return service;
+}
+
+void ServicePool::run() {
+    std::vector<std::thread> threads;
+    threads.reserve(mServices.size() - 1);
+    for (size_t i = 1; i < mServices.size(); ++i) {
+        auto& service = *mServices[i];
+        threads.emplace_back([&service]() {
+            service.run();
+        });
+    }
+    mServices.front()->run();
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+void ServicePool::stop() {
+    for (auto& service : mServices) {
+        service->stop();
+    }
+}
+
+} // namespace tpcc
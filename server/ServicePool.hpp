@@ -0,0 +1,73 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <memory>
+#include <vector>
+#include <boost/asio.hpp>
+
+namespace tpcc {
+
+/**
+ * A set of io_services with one thread each.
+ *
+ * Every connection lives on exactly one of the services, so all its handlers
+ * run on the same thread and no locking is needed for the protocol state.
+ * New connections get spread round-robin over the services.
+ */
+class ServicePool {
+    std::vector<std::unique_ptr<boost::asio::io_service>> mServices;
+    std::vector<std::unique_ptr<boost::asio::io_service::work>> mWork;
+    size_t mNext = 0;
+public:
+    explicit ServicePool(unsigned numThreads);
+
+    /**
+     * The service the acceptor runs on
+     */
+    boost::asio::io_service& acceptorService() {
+        return *mServices.front();
+    }
+
+    /**
+     * The service the next connection should be placed on - only called from
+     * the acceptor.
+     */
+    boost::asio::io_service& next();
+
+    size_t size() const {
+        return mServices.size();
+    }
+
+    boost::asio::io_service& service(size_t i) {
+        return *mServices[i];
+    }
+
+    /**
+     * Runs all services and blocks until they got stopped
+     */
+    void run();
+
+    void stop();
+};
+
+} // namespace tpcc
@@ -0,0 +1,98 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "Statistics.hpp"
+
+namespace tpcc {
+
+Statistics::PerCommand::PerCommand()
+    : commits(0)
+    , aborts(0)
+    , retries(0)
+    , criticalPath(0)
+{
+    for (auto& bucket : latency) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    for (auto& reason : abortReasons) {
+        reason.store(0, std::memory_order_relaxed);
+    }
+}
+
+void Statistics::record(Command command, bool success, AbortReason reason, Clock::time_point start) {
+    auto& stats = mCommands[size_t(command) - 1];
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+    size_t bucket = 0;
+    while (micros > 1 && bucket + 1 < CommandStats::NUM_BUCKETS) {
+        micros >>= 1;
+        ++bucket;
+    }
+    stats.latency[bucket].fetch_add(1, std::memory_order_relaxed);
+    if (success) {
+        stats.commits.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    stats.aborts.fetch_add(1, std::memory_order_relaxed);
+    stats.abortReasons[size_t(reason)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void Statistics::recordRetry(Command command) {
+    mCommands[size_t(command) - 1].retries.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Statistics::recordCriticalPath(Command command, unsigned length) {
+    mCommands[size_t(command) - 1].criticalPath.fetch_add(length, std::memory_order_relaxed);
+}
+
+StatsResult Statistics::snapshot(uint64_t running, uint64_t queued) {
+    StatsResult res;
+    res.running = running;
+    res.queued = queued;
+    for (size_t i = 0; i < mCommands.size(); ++i) {
+        auto& stats = mCommands[i];
+        CommandStats cmd;
+        cmd.command = Command(i + 1);
+        cmd.commits = stats.commits.load(std::memory_order_relaxed);
+        cmd.aborts = stats.aborts.load(std::memory_order_relaxed);
+        cmd.retries = stats.retries.load(std::memory_order_relaxed);
+        cmd.criticalPath = stats.criticalPath.load(std::memory_order_relaxed);
+        if (cmd.commits + cmd.aborts == 0) {
+            continue;
+        }
+        for (size_t reason = 0; reason < NUM_ABORT_REASONS; ++reason) {
+            auto n = stats.abortReasons[reason].load(std::memory_order_relaxed);
+            if (n != 0) {
+                cmd.abortReasons.emplace_back(AbortReason(reason), n);
+            }
+        }
+        for (auto& bucket : stats.latency) {
+            cmd.latencyHistogram.push_back(bucket.load(std::memory_order_relaxed));
+        }
+        while (!cmd.latencyHistogram.empty() && cmd.latencyHistogram.back() == 0) {
+            cmd.latencyHistogram.pop_back();
+        }
+        res.commands.emplace_back(std::move(cmd));
+    }
+    return res;
+}
+
+} // namespace tpcc
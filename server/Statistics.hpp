@@ -0,0 +1,78 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+
+#include <common/Protocol.hpp>
+
+namespace tpcc {
+
+/**
+ * Per command counters of the whole server process.
+ *
+ * Recording is lock free. Aborts are counted per AbortReason, the error
+ * messages carry ids and names and would make the counters grow without bound.
+ */
+class Statistics {
+public:
+    using Clock = std::chrono::steady_clock;
+private:
+    struct PerCommand {
+        std::atomic<uint64_t> commits;
+        std::atomic<uint64_t> aborts;
+        std::atomic<uint64_t> retries;
+        std::atomic<uint64_t> criticalPath;
+        std::array<std::atomic<uint64_t>, CommandStats::NUM_BUCKETS> latency;
+        std::array<std::atomic<uint64_t>, NUM_ABORT_REASONS> abortReasons;
+
+        PerCommand();
+    };
+    std::array<PerCommand, NUM_COMMANDS> mCommands;
+public:
+    /**
+     * Records a transaction which was started at start and just finished
+     */
+    template<class Result>
+    void record(Command command, const Result& result, Clock::time_point start) {
+        record(command, result.success, result.abortReason, start);
+    }
+
+    void record(Command command, bool success, AbortReason reason, Clock::time_point start);
+
+    /**
+     * Records an aborted attempt which gets executed again
+     */
+    void recordRetry(Command command);
+
+    /**
+     * Records the length of the critical path of a committed transaction in
+     * round trips (see CriticalPath)
+     */
+    void recordCriticalPath(Command command, unsigned length);
+
+    StatsResult snapshot(uint64_t running, uint64_t queued);
+};
+
+} // namespace tpcc
@@ -22,71 +22,113 @@
  */
 #include "Transactions.hpp"
 
+#include <algorithm>
+
 using namespace tell::db;
 
 namespace tpcc {
 
+namespace {
+
+// the order lines of the 20 newest orders are one range of the order-line
+// index, which also contains the item
+void scanItems(Transaction& tx, const Tables& tables, const StockLevelIn& in, int32_t d_next_o_id,
+        CriticalPath& path, ArenaVector<int32_t>& ol_i_ids) {
+    auto iter = tx.lower_bound(tables.orderLine, tables.orderLineIdx, {
+            Field(in.w_id),
+            Field(in.d_id),
+            Field(int32_t(d_next_o_id - 20)),
+            Field(int16_t(0)),
+            Field(int32_t(0))});
+    path.sync();
+    for (; !iter.done(); iter.next()) {
+        auto k = iter.key();
+        if (k[0].value<int16_t>() != in.w_id || k[1].value<int16_t>() != in.d_id
+                || k[2].value<int32_t>() >= d_next_o_id) {
+            break;
+        }
+        ol_i_ids.push_back(k[4].value<int32_t>());
+    }
+}
+
+// without the index the 20 newest orders tell how many lines to get
+void readItems(Transaction& tx, const Tables& tables, const StockLevelIn& in, int32_t d_next_o_id,
+        CriticalPath& path, Arena& arena, ArenaVector<int32_t>& ol_i_ids) {
+    ArenaVector<CriticalPath::Request<Tuple>> ordersF(arena);
+    ordersF.reserve(20);
+    OrderKey oKey{in.w_id, in.d_id, 0};
+    for (auto o_id = d_next_o_id - 20; o_id < d_next_o_id; ++o_id) {
+        oKey.o_id = o_id;
+        ordersF.emplace_back(path.issue(tx.get(tables.order, oKey.key())));
+    }
+    ArenaVector<CriticalPath::Request<Tuple>> orderLinesF(arena);
+    orderLinesF.reserve(20 * MAX_ORDER_LINES);
+    OrderlineKey olKey{in.w_id, in.d_id, 0, 0};
+    for (size_t i = 0; i < ordersF.size(); ++i) {
+        auto order = ordersF[i].get();
+        auto o_ol_cnt = tables.orderColumns.get<schema::Order::o_ol_cnt>(order);
+        olKey.o_id = d_next_o_id - 20 + int32_t(i);
+        for (decltype(o_ol_cnt) ol_number = 1; ol_number <= o_ol_cnt; ++ol_number) {
+            olKey.ol_number = ol_number;
+            orderLinesF.emplace_back(path.issue(tx.get(tables.orderLine, olKey.key())));
+        }
+    }
+    for (auto& orderLineF : orderLinesF) {
+        auto orderLine = orderLineF.get();
+        ol_i_ids.push_back(tables.orderLineColumns.get<schema::OrderLine::ol_i_id>(orderLine));
+    }
+}
+
+} // anonymous namespace
+
 StockLevelResult Transactions::stockLevel(Transaction& tx, const StockLevelIn& in) {
     StockLevelResult result;
     try {
-        auto dTableF = tx.openTable("district");
-        auto oTableF = tx.openTable("order");
-        auto olTableF = tx.openTable("order-line");
-        auto sTableF = tx.openTable("stock");
-        auto sTable = sTableF.get();
-        auto olTable = olTableF.get();
-        auto oTable = oTableF.get();
-        auto dTable = dTableF.get();
+        Arena arena;
+        auto tables = mCatalog.tables(tx);
+        // only s_quantity is needed, which stock_counters has as well
+        auto sTable = tables->splitStock ? tables->stockCounters : tables->stock;
+        auto dTable = tables->district;
 
+        CriticalPath path;
         // get District
         DistrictKey dKey{in.w_id, in.d_id};
-        auto districtF = tx.get(dTable, dKey.key());
+        auto districtF = path.issue(tx.get(dTable, dKey.key()));
         auto district = districtF.get();
-        auto d_next_o_id = district.at("d_next_o_id").value<int32_t>();
-        OrderKey oKey{in.w_id, in.d_id, 0};
-        // get the 20 newest orders - this is not required in the benchmark,
-        // but it allows us to not use an index
-        std::vector<std::pair<int32_t, Future<Tuple>>> ordersF;
-        ordersF.reserve(20);
-        for (decltype(d_next_o_id) ol_o_id = d_next_o_id - 20; ol_o_id < d_next_o_id; ++ol_o_id) {
-            oKey.o_id = ol_o_id;
-            ordersF.emplace_back(ol_o_id, tx.get(oTable, oKey.key()));
-        }
-        // get the order-lines
-        std::vector<Future<Tuple>> orderlinesF;
-        OrderlineKey olKey{in.w_id, in.d_id, 0, 0};
-        for (auto& orderF : ordersF) {
-            olKey.o_id = orderF.first;
-            auto order = orderF.second.get();
-            auto o_ol_cnt = order.at("o_ol_cnt").value<int16_t>();
-            for (decltype(o_ol_cnt) ol_number = 1; ol_number <= o_ol_cnt; ++ol_number) {
-                olKey.ol_number = ol_number;
-                orderlinesF.emplace_back(tx.get(olTable, olKey.key()));
-            }
+        auto d_next_o_id = tables->districtColumns.get<schema::District::d_next_o_id>(district);
+        ArenaVector<int32_t> ol_i_ids(arena);
+        ol_i_ids.reserve(20 * MAX_ORDER_LINES);
+        if (tables->hasOrderLineIdx) {
+            scanItems(tx, *tables, in, d_next_o_id, path, ol_i_ids);
+        } else {
+            readItems(tx, *tables, in, d_next_o_id, path, arena, ol_i_ids);
         }
         result.low_stock = 0;
-        // count low_stock
-        std::unordered_map<int32_t, Future<Tuple>> stocksF;
-        for (auto& olF : orderlinesF) {
-            auto ol = olF.get();
-            auto ol_i_id = ol.at("ol_i_id").value<int32_t>();
-            if (stocksF.count(ol_i_id) == 0) {
-                stocksF.emplace(ol_i_id, tx.get(sTable, tell::db::key_t{(uint64_t(in.w_id) << 4*8) | uint64_t(ol_i_id)}));
-            }
+        // count low_stock - every distinct item only once
+        std::sort(ol_i_ids.begin(), ol_i_ids.end());
+        ol_i_ids.erase(std::unique(ol_i_ids.begin(), ol_i_ids.end()), ol_i_ids.end());
+        ArenaVector<CriticalPath::Request<Tuple>> stocksF(arena);
+        stocksF.reserve(ol_i_ids.size());
+        for (auto ol_i_id : ol_i_ids) {
+            stocksF.emplace_back(path.issue(tx.get(sTable, StockKey(in.w_id, ol_i_id).key())));
         }
-        for (auto& p : stocksF) {
-            auto stock = p.second.get();
-            auto quantity = stock.at("s_quantity").value<int32_t>();
+        for (auto& stockF : stocksF) {
+            auto stock = stockF.get();
+            auto quantity = tables->splitStock
+                ? tables->stockCountersColumns.get<schema::StockCounters::s_quantity>(stock)
+                : tables->stockColumns.get<schema::Stock::s_quantity>(stock);
             if (quantity < in.threshold) {
                 ++result.low_stock;
             }
         }
         tx.commit();
+        mStatistics.recordCriticalPath(Command::STOCK_LEVEL, path.length());
         result.success = true;
         return result;
     } catch (std::exception& ex) {
         result.success = false;
         result.error = ex.what();
+        result.abortReason = classifyAbort(ex);
     }
     return result;
 }
@@ -0,0 +1,87 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "TableCatalog.hpp"
+
+#include <telldb/Transaction.hpp>
+
+namespace tpcc {
+
+std::shared_ptr<const Tables> TableCatalog::tables(tell::db::Transaction& tx) {
+    auto tables = std::atomic_load(&mTables);
+    if (tables) {
+        return tables;
+    }
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> _(mMutex);
+        generation = mGeneration;
+    }
+    // we must not hold the mutex while waiting, this would block the other
+    // fibers of the thread - at worst a few transactions resolve concurrently
+    auto wTableF = tx.openTable(schema::Warehouse::name());
+    auto dTableF = tx.openTable(schema::District::name());
+    auto cTableF = tx.openTable(mLayout.splitCustomer ? schema::CustomerCore::name() : schema::Customer::name());
+    auto hTableF = tx.openTable(schema::History::name());
+    auto noTableF = tx.openTable(schema::NewOrder::name());
+    auto oTableF = tx.openTable(schema::Order::name());
+    auto olTableF = tx.openTable(schema::OrderLine::name());
+    auto iTableF = tx.openTable(schema::Item::name());
+    auto resolved = std::make_shared<Tables>();
+    resolved->hasOrderLineIdx = mLayout.orderLineIndex;
+    resolved->splitStock = mLayout.splitStock;
+    resolved->splitCustomer = mLayout.splitCustomer;
+    if (mLayout.splitCustomer) {
+        resolved->customerInfo = tx.openTable(schema::CustomerInfo::name()).get();
+    }
+    if (mLayout.splitStock) {
+        auto sCountersF = tx.openTable(schema::StockCounters::name());
+        auto sInfoF = tx.openTable(schema::StockInfo::name());
+        resolved->stockCounters = sCountersF.get();
+        resolved->stockInfo = sInfoF.get();
+    } else {
+        resolved->stock = tx.openTable(schema::Stock::name()).get();
+    }
+    resolved->generation = generation;
+    resolved->warehouse = wTableF.get();
+    resolved->district = dTableF.get();
+    resolved->customer = cTableF.get();
+    resolved->history = hTableF.get();
+    resolved->newOrder = noTableF.get();
+    resolved->order = oTableF.get();
+    resolved->orderLine = olTableF.get();
+    resolved->item = iTableF.get();
+    tables = std::move(resolved);
+    std::lock_guard<std::mutex> _(mMutex);
+    if (generation == mGeneration) {
+        std::atomic_store(&mTables, tables);
+    }
+    return tables;
+}
+
+void TableCatalog::invalidate() {
+    std::lock_guard<std::mutex> _(mMutex);
+    ++mGeneration;
+    std::atomic_store(&mTables, std::shared_ptr<const Tables>());
+}
+
+} // namespace tpcc
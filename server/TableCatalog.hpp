@@ -0,0 +1,115 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include <crossbow/string.hpp>
+#include <telldb/Types.hpp>
+
+#include "Schema.hpp"
+#include "CreateSchema.hpp"
+
+namespace tpcc {
+
+/**
+ * The handles of all tables the benchmark transactions work on, together with
+ * the names of the secondary indexes they scan and the field ids.
+ */
+struct Tables {
+    // the catalog generation these handles were resolved in
+    uint64_t generation = 0;
+
+    tell::db::table_t warehouse;
+    tell::db::table_t district;
+    // customer_core if the customer table is split, see SchemaLayout
+    bool splitCustomer = false;
+    tell::db::table_t customer;
+    tell::db::table_t customerInfo;
+    tell::db::table_t history;
+    tell::db::table_t newOrder;
+    tell::db::table_t order;
+    tell::db::table_t orderLine;
+    tell::db::table_t item;
+    // only one of stock and stockCounters/stockInfo exists, see SchemaLayout
+    bool splitStock = false;
+    tell::db::table_t stock;
+    tell::db::table_t stockCounters;
+    tell::db::table_t stockInfo;
+
+    crossbow::string customerLastNameIdx = "c_last_idx";
+    crossbow::string newOrderIdx = "new-order-idx";
+    crossbow::string orderIdx = "order_idx";
+    // only exists with SchemaLayout::orderLineIndex
+    bool hasOrderLineIdx = false;
+    crossbow::string orderLineIdx = "order-line-idx";
+
+    Columns<schema::Warehouse> warehouseColumns;
+    Columns<schema::District> districtColumns;
+    Columns<schema::Customer> customerColumns;
+    Columns<schema::CustomerCore> customerCoreColumns;
+    Columns<schema::CustomerInfo> customerInfoColumns;
+    Columns<schema::Order> orderColumns;
+    Columns<schema::OrderLine> orderLineColumns;
+    Columns<schema::Item> itemColumns;
+    Columns<schema::Stock> stockColumns;
+    Columns<schema::StockCounters> stockCountersColumns;
+    Columns<schema::StockInfo> stockInfoColumns;
+};
+
+/**
+ * Resolves the table handles once per client manager instead of once per
+ * transaction.
+ *
+ * The first transaction which needs them opens all tables, every later one
+ * just takes the cached handles. Table ids only change when the schema gets
+ * created (again), so invalidate has to be called after CREATE_SCHEMA
+ * committed.
+ */
+class TableCatalog {
+    SchemaLayout mLayout;
+    std::mutex mMutex;
+    std::shared_ptr<const Tables> mTables;
+    // incremented on every invalidation, so that a resolution which raced with
+    // it does not install stale handles
+    uint64_t mGeneration = 0;
+public:
+    explicit TableCatalog(const SchemaLayout& layout)
+        : mLayout(layout)
+    {}
+
+    const SchemaLayout& layout() const {
+        return mLayout;
+    }
+
+    /**
+     * Returns the cached handles or resolves them within tx - the result stays
+     * valid even if the catalog gets invalidated in the meantime.
+     */
+    std::shared_ptr<const Tables> tables(tell::db::Transaction& tx);
+
+    void invalidate();
+};
+
+} // namespace tpcc
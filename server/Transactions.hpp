@@ -25,27 +25,58 @@
 #include <common/Protocol.hpp>
 #include <common/Util.hpp>
 #include "CreateSchema.hpp"
+#include "TableCatalog.hpp"
+#include "RetryPolicy.hpp"
+#include "Arena.hpp"
+#include "HistoryIds.hpp"
+#include "ItemCache.hpp"
+#include "CriticalPath.hpp"
+#include "Statistics.hpp"
+
+#include <array>
+#include <stdexcept>
 
 namespace tpcc {
 
+/**
+ * Thrown if a tuple the input of a transaction refers to does not exist
+ */
+struct NotFound : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
 class Transactions {
-    int16_t mNumWarehouses;
-    Random_t& rnd;
+    TableCatalog& mCatalog;
+    Statistics& mStatistics;
+    // nullptr if items are always read from the storage
+    ItemCache* mItems;
+    HistoryIds mHistoryIds;
 public:
-    Transactions(int16_t numWarehouses) : mNumWarehouses(numWarehouses), rnd(*Random()) {}
+    Transactions(TableCatalog& catalog, Statistics& statistics, ItemCache* items)
+        : mCatalog(catalog), mStatistics(statistics), mItems(items) {}
 public:
-    NewOrderResult newOrderTransaction(tell::db::Transaction& tx, const NewOrderIn& in);
+    /**
+     * mode is the result mode of the connection when the request arrived
+     */
+    NewOrderResult newOrderTransaction(tell::db::Transaction& tx, const NewOrderIn& in, ResultMode mode);
     PaymentResult payment(tell::db::Transaction& tx, const PaymentIn& in);
     OrderStatusResult orderStatus(tell::db::Transaction& tx, const OrderStatusIn& in);
-    DeliveryResult delivery(tell::db::Transaction& tx, const DeliveryIn& in);
+    /**
+     * Writes the order delivered per district into delivered (0 for districts
+     * without a new order) if the transaction committed.
+     */
+    DeliveryResult delivery(tell::db::Transaction& tx, const DeliveryIn& in,
+            std::array<int32_t, 10>* delivered = nullptr);
     StockLevelResult stockLevel(tell::db::Transaction& tx, const StockLevelIn& in);
 private:
-    tell::db::Future<tell::db::Tuple> getCustomer(tell::db::Transaction& tx,
+    CriticalPath::Request<tell::db::Tuple> getCustomer(tell::db::Transaction& tx,
             bool selectByLastName,
             const crossbow::string& c_last,
             int16_t c_w_id,
             int16_t c_d_id, int32_t c_id,
-            tell::db::table_t customerTable,
+            const Tables& tables,
+            Arena& arena,
+            CriticalPath& path,
             CustomerKey& customerKey);
 };
 
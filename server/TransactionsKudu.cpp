@@ -24,6 +24,7 @@
 #include "kudu.hpp"
 #include <kudu/client/row_result.h>
 
+#include <boost/optional.hpp>
 #include <boost/unordered_map.hpp>
 
 namespace tpcc {
@@ -107,6 +108,25 @@ KuduRowResult get(KuduTable& table, ScannerList& scanners, const Args&... args)
     return rows[0];
 }
 
+/**
+ * Like get, but returns none instead of asserting if there is no such row
+ */
+template<class... Args>
+boost::optional<KuduRowResult> tryGet(KuduTable& table, ScannerList& scanners, const Args&... args) {
+    scanners.emplace_back(new KuduScanner(&table));
+    auto& scanner = *scanners.back();
+    addPredicates(table, scanner, args...);
+    assertOk(scanner.Open());
+    std::vector<KuduRowResult> rows;
+    while (rows.empty() && scanner.HasMoreRows()) {
+        assertOk(scanner.NextBatch(&rows));
+    }
+    if (rows.empty()) {
+        return boost::none;
+    }
+    return rows[0];
+}
+
 void set(KuduWriteOperation& upd, const Slice& slice, int16_t v) {
     assertOk(upd.mutable_row()->SetInt16(slice, v));
 }
@@ -136,8 +156,9 @@ struct NewStock {
     int16_t s_remote_cnt;
 };
 
-NewOrderResult Transactions::newOrderTransaction(KuduSession& session, const NewOrderIn& in) {
+NewOrderResult Transactions::newOrderTransaction(KuduSession& session, const NewOrderIn& in, ResultMode mode) {
     NewOrderResult result;
+    result.statusOnly = mode == ResultMode::STATUS_ONLY;
     std::tr1::shared_ptr<KuduTable> wTable;
     std::tr1::shared_ptr<KuduTable> cTable;
     std::tr1::shared_ptr<KuduTable> dTable;
@@ -156,6 +177,25 @@ NewOrderResult Transactions::newOrderTransaction(KuduSession& session, const New
     assertOk(session.client()->OpenTable("stock", &sTable));
 
     ScannerList scanners;
+    // 1% of the orders refer to an unused item, this has to be found out
+    // before anything is written
+    auto o_ol_cnt = in.o_ol_cnt;
+    boost::unordered_map<int32_t, KuduRowResult> items;
+    items.reserve(o_ol_cnt);
+    for (int16_t i = 0; i < o_ol_cnt; ++i) {
+        auto i_id = in.lines[i].ol_i_id;
+        if (items.count(i_id) != 0) {
+            continue;
+        }
+        auto item = tryGet(*iTable, scanners, "i_id", i_id);
+        if (!item) {
+            result.success = false;
+            result.error = "Item number is not valid";
+            result.abortReason = AbortReason::ROLLBACK;
+            return result;
+        }
+        items.emplace(i_id, *item);
+    }
     auto warehouse = get(*wTable, scanners, "w_id", in.w_id);
     auto customer = get(*cTable, scanners, "c_w_id", in.w_id, "c_d_id", in.d_id, "c_id", in.c_id);
     auto district = get(*dTable, scanners, "d_w_id", in.w_id, "d_id", in.d_id);
@@ -170,15 +210,9 @@ NewOrderResult Transactions::newOrderTransaction(KuduSession& session, const New
 
     auto o_id = d_next_o_id;
     int16_t o_all_local = 1;
-    int16_t o_ol_cnt = rnd.randomWithin<int16_t>(5, 15);
-    std::vector<int16_t> ol_supply_w_id(o_ol_cnt);
-    for (auto& i : ol_supply_w_id) {
-        i = in.w_id;
-        if (mNumWarehouses > 1 && rnd.randomWithin<int>(1, 100) == 1) {
+    for (int16_t i = 0; i < o_ol_cnt; ++i) {
+        if (in.lines[i].ol_supply_w_id != in.w_id) {
             o_all_local = 0;
-            while (i == in.w_id) {
-                i = rnd.randomWithin<int16_t>(1, mNumWarehouses);
-            }
         }
     }
     std::vector<std::unique_ptr<KuduWriteOperation>> operations;
@@ -200,24 +234,11 @@ NewOrderResult Transactions::newOrderTransaction(KuduSession& session, const New
     set(*ins, "no_w_id", in.w_id);
     operations.emplace_back(ins.release());
 
-    std::vector<int32_t> ol_i_id;
-    ol_i_id.reserve(o_ol_cnt);
-    for (int16_t i = 0; i < o_ol_cnt; ++i) {
-        auto i_id = rnd.NURand<int32_t>(8191,1,100000);
-        ol_i_id.push_back(i_id);
-    }
-    // get the items
     // get the stocks
-    boost::unordered_map<int32_t, KuduRowResult> items;
     boost::unordered_map<std::tuple<int16_t, int32_t>, KuduRowResult> stocks;
-    items.reserve(o_ol_cnt);
     stocks.reserve(o_ol_cnt);
     for (int16_t i = 0; i < o_ol_cnt; ++i) {
-        auto i_id = ol_i_id[i];
-        if (items.count(i_id) == 0) {
-            items.emplace(i_id, get(*iTable, scanners, "i_id", i_id));
-        }
-        auto sKey = std::make_tuple(ol_supply_w_id[i], i_id);
+        auto sKey = std::make_tuple(in.lines[i].ol_supply_w_id, in.lines[i].ol_i_id);
         if (stocks.count(sKey) == 0) {
             stocks.emplace(sKey, get(*sTable, scanners, "s_w_id", std::get<0>(sKey), "s_i_id", std::get<1>(sKey)));
         }
@@ -246,15 +267,15 @@ NewOrderResult Transactions::newOrderTransaction(KuduSession& session, const New
     std::vector<std::string> strings;
     for (int16_t i = 0; i < o_ol_cnt; ++i) {
         int16_t ol_number = i + 1;
-        //ItemKey itemId(ol_i_id[i]);
-        auto& item = items.at(ol_i_id[i]);
-        auto stockId = std::make_tuple(ol_supply_w_id[i], ol_i_id[i]);
+        const auto& line = in.lines[i];
+        auto& item = items.at(line.ol_i_id);
+        auto stockId = std::make_tuple(line.ol_supply_w_id, line.ol_i_id);
         auto& stock = stocks.at(stockId);
         kudu::Slice ol_dist_info_slice;
         assertOk(stock.GetString(ol_dist_info_key, &ol_dist_info_slice));
         strings.emplace_back(ol_dist_info_slice.ToString());
         auto& ol_dist_info = strings.back();
-        auto ol_quantity = rnd.randomWithin<int16_t>(1, 10);
+        auto ol_quantity = line.ol_quantity;
         auto& newStock = newStocks.at(stockId);
         if (newStock.s_quantity > ol_quantity + 10) {
             newStock.s_quantity -= ol_quantity;
@@ -263,7 +284,7 @@ NewOrderResult Transactions::newOrderTransaction(KuduSession& session, const New
         }
         newStock.s_ytd += ol_quantity;
         ++newStock.s_order_cnt;
-        if (ol_supply_w_id[i] != in.w_id) ++newStock.s_remote_cnt;
+        if (line.ol_supply_w_id != in.w_id) ++newStock.s_remote_cnt;
         int32_t i_price;
         assertOk(item.GetInt32("i_price", &i_price));
         int32_t ol_amount = i_price * int32_t(ol_quantity);
@@ -274,19 +295,22 @@ NewOrderResult Transactions::newOrderTransaction(KuduSession& session, const New
         set(*ins, "ol_d_id", in.d_id);
         set(*ins, "ol_w_id", in.w_id);
         set(*ins, "ol_number", ol_number);
-        set(*ins, "ol_i_id", ol_i_id[i]);
-        set(*ins, "ol_supply_w_id", ol_supply_w_id[i]);
+        set(*ins, "ol_i_id", line.ol_i_id);
+        set(*ins, "ol_supply_w_id", line.ol_supply_w_id);
         set(*ins, "ol_delivery_d", nullptr);
         set(*ins, "ol_quantity", ol_quantity);
         set(*ins, "ol_amount", ol_amount);
         set(*ins, "ol_dist_info", ol_dist_info);
+        if (result.statusOnly) {
+            continue;
+        }
         // set Result for this order line
         Slice i_data, s_data;
         assertOk(item.GetString("i_data", &i_data));
         assertOk(stock.GetString("s_data", &s_data));
         NewOrderResult::OrderLine lineRes;
-        lineRes.ol_supply_w_id = ol_supply_w_id[i];
-        lineRes.ol_i_id = ol_i_id[i];
+        lineRes.ol_supply_w_id = line.ol_supply_w_id;
+        lineRes.ol_i_id = line.ol_i_id;
         Slice i_name;
         assertOk(item.GetString("i_name", &i_name));
         lineRes.i_name = i_name.ToString();
@@ -315,14 +339,9 @@ NewOrderResult Transactions::newOrderTransaction(KuduSession& session, const New
         set(*upd, "s_remote_cnt", nStock.s_remote_cnt);
         operations.emplace_back(std::move(upd));
     }
-    // 1% of transactions need to abort
-    if (rnd.randomWithin<int>(1, 100) == 1) {
-        result.success = false;
-        result.error = "Item number is not valid";
-        result.lines.clear();
-    } else {
-        // write single-line results
-        result.o_id = o_id;
+    // write single-line results
+    result.o_id = o_id;
+    if (!result.statusOnly) {
         result.o_ol_cnt = o_ol_cnt;
         Slice c_last, c_credit;
         assertOk(customer.GetString("c_last", &c_last));
@@ -453,6 +472,7 @@ OrderStatusResult Transactions::orderStatus(KuduSession& session, const OrderSta
             errstream << "Customer name=" << in.c_last << ", w_id=" << in.w_id << ", d_id=" << in.d_id << ", c_id="
                 << cKey.c_id << " does not exist";
             result.error = errstream.str();
+            result.abortReason = AbortReason::NOT_FOUND;
             return result;
         }
         auto order = get(*oTable, scanners, "o_w_id", oKey.o_w_id, "o_d_id", oKey.o_d_id, "o_id", oKey.o_id);
@@ -468,6 +488,7 @@ OrderStatusResult Transactions::orderStatus(KuduSession& session, const OrderSta
     } catch (std::exception& ex) {
         result.success = false;
         result.error = ex.what();
+        result.abortReason = AbortReason::OTHER;
     }
     return result;
 }
@@ -534,7 +555,7 @@ PaymentResult Transactions::payment(KuduSession& session, const PaymentIn& in) {
             set(*upd, "c_id", c_id);
             set(*upd, "c_balance", int64_t(c_balance + in.h_amount));
             set(*upd, "c_ytd_payment", int64_t(c_ytd_payment + in.h_amount));
-            set(*upd, "c_payment_cnt", int16_t(c_payment_cnt + in.h_amount));
+            set(*upd, "c_payment_cnt", int16_t(c_payment_cnt + 1));
             if (c_credit == "BC") {
                 std::string histInfo = "(" + std::to_string(customerKey.c_id) +
                     "," + std::to_string(c_d_id) + "," + std::to_string(c_w_id) +
@@ -579,6 +600,7 @@ PaymentResult Transactions::payment(KuduSession& session, const PaymentIn& in) {
     } catch (std::exception& ex) {
         result.success = false;
         result.error = ex.what();
+        result.abortReason = AbortReason::OTHER;
     }
     return result;
 }
@@ -687,6 +709,7 @@ DeliveryResult Transactions::delivery(KuduSession& session, const DeliveryIn& in
     } catch (std::exception& ex) {
         result.success = false;
         result.error = ex.what();
+        result.abortReason = AbortReason::OTHER;
     }
     return result;
 }
@@ -746,6 +769,7 @@ StockLevelResult Transactions::stockLevel(KuduSession& session, const StockLevel
     } catch (std::exception& ex) {
         result.success = false;
         result.error = ex.what();
+        result.abortReason = AbortReason::OTHER;
     }
     return result;
 }
@@ -28,12 +28,8 @@
 namespace tpcc {
 
 class Transactions {
-    int16_t mNumWarehouses;
-    Random_t& rnd;
 public:
-    Transactions(int16_t numWarehouses) : mNumWarehouses(numWarehouses), rnd(*Random()) {}
-public:
-    NewOrderResult newOrderTransaction(kudu::client::KuduSession& session, const NewOrderIn& in);
+    NewOrderResult newOrderTransaction(kudu::client::KuduSession& session, const NewOrderIn& in, ResultMode mode);
     PaymentResult payment(kudu::client::KuduSession& session, const PaymentIn& in);
     OrderStatusResult orderStatus(kudu::client::KuduSession& session, const OrderStatusIn& in);
     DeliveryResult delivery(kudu::client::KuduSession& session, const DeliveryIn& in);
@@ -0,0 +1,62 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "WarehouseAffinity.hpp"
+#include "ServicePool.hpp"
+
+#include <cassert>
+
+namespace tpcc {
+
+WarehouseAffinity::WarehouseAffinity(ServicePool& pool, unsigned maxPerWarehouse)
+    : mMaxPerWarehouse(maxPerWarehouse)
+{
+    mLanes.resize(pool.size());
+    for (size_t i = 0; i < mLanes.size(); ++i) {
+        mLanes[i].service = &pool.service(i);
+    }
+}
+
+void WarehouseAffinity::enter(int16_t w_id, std::function<void()> start) {
+    auto& warehouse = lane(w_id).warehouses[w_id];
+    if (mMaxPerWarehouse != 0 && warehouse.running >= mMaxPerWarehouse) {
+        warehouse.waiting.emplace_back(std::move(start));
+        return;
+    }
+    ++warehouse.running;
+    start();
+}
+
+void WarehouseAffinity::leave(int16_t w_id) {
+    auto& warehouse = lane(w_id).warehouses[w_id];
+    assert(warehouse.running > 0);
+    if (warehouse.waiting.empty()) {
+        --warehouse.running;
+        return;
+    }
+    // the slot goes directly to the oldest waiter
+    auto next = std::move(warehouse.waiting.front());
+    warehouse.waiting.pop_front();
+    next();
+}
+
+} // namespace tpcc
@@ -0,0 +1,92 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+namespace tpcc {
+
+class ServicePool;
+
+/**
+ * Assigns every warehouse to one of the server threads.
+ *
+ * The bookkeeping of starting and finishing the transactions of a warehouse
+ * runs on the thread it is assigned to, which serializes it per warehouse -
+ * the transaction bodies still run as TellDB fibers on TellDB's threads.
+ * Optionally it also limits how many read-write transactions per warehouse
+ * run at the same time: with a limit of one, transactions which would
+ * certainly conflict on w_ytd, d_ytd or d_next_o_id wait here instead of being
+ * aborted by the storage.
+ *
+ * The per warehouse state is only touched from the thread of the warehouse, so
+ * no locking is needed.
+ */
+class WarehouseAffinity {
+    struct Warehouse {
+        unsigned running = 0;
+        std::deque<std::function<void()>> waiting;
+    };
+    struct Lane {
+        boost::asio::io_service* service;
+        std::unordered_map<int16_t, Warehouse> warehouses;
+    };
+    std::vector<Lane> mLanes;
+    unsigned mMaxPerWarehouse;
+public:
+    /**
+     * A limit of 0 means unlimited
+     */
+    WarehouseAffinity(ServicePool& pool, unsigned maxPerWarehouse);
+
+    /**
+     * The service all transactions of w_id are started and finished on
+     */
+    boost::asio::io_service& service(int16_t w_id) {
+        return *lane(w_id).service;
+    }
+
+    /**
+     * Calls start as soon as the warehouse is below its limit - has to be
+     * called on service(w_id).
+     */
+    void enter(int16_t w_id, std::function<void()> start);
+
+    /**
+     * Has to be called on service(w_id) for every transaction which entered
+     * when it finished.
+     */
+    void leave(int16_t w_id);
+
+private:
+    Lane& lane(int16_t w_id) {
+        return mLanes[size_t(w_id) % mLanes.size()];
+    }
+};
+
+} // namespace tpcc
@@ -30,6 +30,9 @@
 
 #include <common/Protocol.hpp>
 #include "kudu.hpp"
+#include "ServicePool.hpp"
+#include "Listener.hpp"
+#include "Statistics.hpp"
 #include "CreateSchemaKudu.hpp"
 #include "PopulateKudu.hpp"
 #include "TransactionsKudu.hpp"
@@ -49,27 +52,33 @@ void assertOk(kudu::Status status) {
 using Session = std::tr1::shared_ptr<kudu::client::KuduSession>;
 
 class Connection {
-    boost::asio::ip::tcp::socket mSocket;
+    std::unique_ptr<Stream> mStream;
     server::Server<Connection> mServer;
+    ServicePool& mPool;
+    Statistics& mStatistics;
     Session mSession;
     Populator mPopulator;
     Transactions mTxs;
+    ResultMode mResultMode = ResultMode::FULL;
     int mPartitions;
 public:
-    Connection(boost::asio::io_service& service, kudu::client::KuduClient& client, int16_t numWarehouses, int partitions)
-        : mSocket(service)
-        , mServer(*this, mSocket)
+    Connection(std::unique_ptr<Stream> stream, ServicePool& pool, Statistics& statistics,
+            kudu::client::KuduClient& client, int partitions)
+        : mStream(std::move(stream))
+        , mServer(*this, *mStream)
+        , mPool(pool)
+        , mStatistics(statistics)
         , mSession(client.NewSession())
-        , mTxs(numWarehouses)
         , mPartitions(partitions)
     {
         assertOk(mSession->SetFlushMode(kudu::client::KuduSession::MANUAL_FLUSH));
         mSession->SetTimeoutMillis(60000);
     }
     ~Connection() = default;
-    decltype(mSocket)& socket() { return mSocket; }
     void run() {
-        mServer.run();
+        mStream->service().post([this]() {
+            mServer.run();
+        });
     }
 
     void close() {
@@ -79,10 +88,26 @@ public:
     template<Command C, class Callback>
     typename std::enable_if<C == Command::EXIT, void>::type
     execute(const Callback callback) {
-        mServer.quit();
+        mServer.quit([this]() {
+            mPool.stop();
+        });
         callback();
     }
 
+    template<Command C, class Callback>
+    typename std::enable_if<C == Command::STATS, void>::type
+    execute(const Callback callback) {
+        // transactions run synchronously, so nothing is ever queued
+        callback(mStatistics.snapshot(0, 0));
+    }
+
+    template<Command C, class Callback>
+    typename std::enable_if<C == Command::SET_RESULT_MODE, void>::type
+    execute(ResultMode mode, const Callback& callback) {
+        mResultMode = mode;
+        callback(mode);
+    }
+
     template<Command C, class Callback>
     typename std::enable_if<C == Command::CREATE_SCHEMA, void>::type
     execute(std::tuple<int16_t, bool> args, const Callback& callback) {
@@ -109,66 +134,68 @@ public:
     template<Command C, class Callback>
     typename std::enable_if<C == Command::NEW_ORDER, void>::type
     execute(const typename Signature<C>::arguments& args, const Callback& callback) {
-        callback(mTxs.newOrderTransaction(*mSession, args));
+        auto start = Statistics::Clock::now();
+        auto res = mTxs.newOrderTransaction(*mSession, args, mResultMode);
+        mStatistics.record(C, res, start);
+        callback(res);
     }
 
     template<Command C, class Callback>
     typename std::enable_if<C == Command::PAYMENT, void>::type
     execute(const typename Signature<C>::arguments& args, const Callback& callback) {
-        callback(mTxs.payment(*mSession, args));
+        auto start = Statistics::Clock::now();
+        auto res = mTxs.payment(*mSession, args);
+        mStatistics.record(C, res, start);
+        callback(res);
     }
 
     template<Command C, class Callback>
     typename std::enable_if<C == Command::ORDER_STATUS, void>::type
     execute(const typename Signature<C>::arguments& args, const Callback& callback) {
-        callback(mTxs.orderStatus(*mSession, args));
+        auto start = Statistics::Clock::now();
+        auto res = mTxs.orderStatus(*mSession, args);
+        mStatistics.record(C, res, start);
+        callback(res);
     }
 
     template<Command C, class Callback>
     typename std::enable_if<C == Command::DELIVERY, void>::type
     execute(const typename Signature<C>::arguments& args, const Callback& callback) {
-        callback(mTxs.delivery(*mSession, args));
+        auto start = Statistics::Clock::now();
+        auto res = mTxs.delivery(*mSession, args);
+        mStatistics.record(C, res, start);
+        callback(res);
     }
 
     template<Command C, class Callback>
     typename std::enable_if<C == Command::STOCK_LEVEL, void>::type
     execute(const typename Signature<C>::arguments& args, const Callback& callback) {
-        callback(mTxs.stockLevel(*mSession, args));
+        auto start = Statistics::Clock::now();
+        auto res = mTxs.stockLevel(*mSession, args);
+        mStatistics.record(C, res, start);
+        callback(res);
     }
 };
 
-void accept(io_service& service, ip::tcp::acceptor& a, kudu::client::KuduClient& client, int16_t numWarehouses, int partitions) {
-    auto conn = new Connection(service, client, numWarehouses, partitions);
-    a.async_accept(conn->socket(), [&, conn, numWarehouses, partitions](const boost::system::error_code& err) {
-        if (err) {
-            delete conn;
-            LOG_ERROR(err.message());
-            return;
-        }
-        conn->run();
-        accept(service, a, client, numWarehouses, partitions);
-    });
-}
-
 }
 
 int main(int argc, const char* argv[]) {
     bool help = false;
     std::string host;
     std::string port("8713");
+    std::string transport("tcp");
     std::string logLevel("DEBUG");
     crossbow::string storageNodes;
-    int16_t numWarehouses = 0;
     unsigned numThreads = 1;
     int partitions = -1;
     auto opts = create_options("tpcc_server",
             value<'h'>("help", &help, tag::description{"print help"}),
-            value<'H'>("host", &host, tag::description{"Host to bind to"}),
+            value<'H'>("host", &host, tag::description{"Host to bind to (socket path for unix and shm)"}),
             value<'p'>("port", &port, tag::description{"Port to bind to"}),
+            value<'T'>("transport", &transport, tag::description{"Transport to the clients: tcp, unix or shm"}),
             value<'P'>("partitions", &partitions, tag::description{"Number of partitions per table"}),
             value<'l'>("log-level", &logLevel, tag::description{"The log level"}),
             value<'s'>("storage-nodes", &storageNodes, tag::description{"Semicolon-separated list of storage node addresses"}),
-            value<'W'>("num-warehouses", &numWarehouses, tag::description{"Number of warehouses"}),
             value<-1>("network-threads", &numThreads, tag::ignore_short<true>{})
             );
     try {
@@ -182,10 +209,6 @@ int main(int argc, const char* argv[]) {
         print_help(std::cout, opts);
         return 0;
     }
-    if (numWarehouses == 0) {
-        std::cerr << "Number of warehouses needs to be set" << std::endl;
-        return 1;
-    }
     if (partitions == -1) {
         std::cerr << "Number of partitions needs to be set" << std::endl;
         return 1;
@@ -193,53 +216,20 @@ int main(int argc, const char* argv[]) {
 
     crossbow::logger::logger->config.level = crossbow::logger::logLevelFromString(logLevel);
     try {
-        io_service service;
-        boost::asio::io_service::work work(service);
-        ip::tcp::acceptor a(service);
-        boost::asio::ip::tcp::acceptor::reuse_address option(true);
-        ip::tcp::resolver resolver(service);
-        ip::tcp::resolver::iterator iter;
-        if (host == "") {
-            iter = resolver.resolve(ip::tcp::resolver::query(port));
-        } else {
-            iter = resolver.resolve(ip::tcp::resolver::query(host, port));
-        }
-        ip::tcp::resolver::iterator end;
-        for (; iter != end; ++iter) {
-            boost::system::error_code err;
-            auto endpoint = iter->endpoint();
-            auto protocol = iter->endpoint().protocol();
-            a.open(protocol);
-            a.set_option(option);
-            a.bind(endpoint, err);
-            if (err) {
-                a.close();
-                LOG_WARN("Bind attempt failed " + err.message());
-                continue;
-            }
-            break;
-        }
-        if (!a.is_open()) {
-            LOG_ERROR("Could not bind");
-            return 1;
-        }
-        a.listen();
+        tpcc::ServicePool pool(numThreads);
+        tpcc::Statistics statistics;
+        tpcc::Listener listener(pool, tpcc::transportFromString(transport), host, port);
         // Connect to Kudu
         kudu::client::KuduClientBuilder clientBuilder;
         clientBuilder.add_master_server_addr(storageNodes.c_str());
         std::tr1::shared_ptr<kudu::client::KuduClient> client;
         tpcc::assertOk(clientBuilder.Build(&client));
-        // we do not need to delete this object, it will delete itself
-        tpcc::accept(service, a, *client, numWarehouses, partitions);
-        std::vector<std::thread> threads;
-        for (unsigned i = 0; i < numThreads; ++i) {
-            threads.emplace_back([&service](){
-                    service.run();
-            });
-        }
-        for (auto& t : threads) {
-            t.join();
-        }
+        listener.accept([&pool, &statistics, &client, partitions](std::unique_ptr<tpcc::Stream> stream) {
+            // we do not need to delete this object, it will delete itself
+            auto conn = new tpcc::Connection(std::move(stream), pool, statistics, *client, partitions);
+            conn->run();
+        });
+        pool.run();
     } catch (std::exception& e) {
         std::cerr << e.what() << std::endl;
     }
@@ -21,6 +21,15 @@
  *     Lucas Braun <braunl@inf.ethz.ch>
  */
 #include "Connection.hpp"
+#include "ServicePool.hpp"
+#include "Listener.hpp"
+#include "AdmissionControl.hpp"
+#include "Statistics.hpp"
+#include "RetryPolicy.hpp"
+#include "WarehouseAffinity.hpp"
+#include "DeliveryQueue.hpp"
+#include "ItemCache.hpp"
+#include "TableCatalog.hpp"
 #include <crossbow/allocator.hpp>
 #include <crossbow/program_options.hpp>
 #include <crossbow/logger.hpp>
@@ -29,44 +38,74 @@
 #include <boost/asio.hpp>
 #include <string>
 #include <iostream>
+#include <thread>
 
 using namespace crossbow::program_options;
 using namespace boost::asio;
 
-void accept(boost::asio::io_service &service,
-        boost::asio::ip::tcp::acceptor &a,
-        tell::db::ClientManager<void>& clientManager,
-        int16_t numWarehouses) {
-    auto conn = new tpcc::Connection(service, clientManager, numWarehouses);
-    a.async_accept(conn->socket(), [conn, &service, &a, &clientManager, numWarehouses](const boost::system::error_code &err) {
-        if (err) {
-            delete conn;
-            LOG_ERROR(err.message());
-            return;
-        }
-        conn->run();
-        accept(service, a, clientManager, numWarehouses);
-    });
-}
-
 int main(int argc, const char** argv) {
     bool help = false;
     std::string host;
     std::string port("8713");
+    std::string transport("tcp");
     std::string logLevel("DEBUG");
     crossbow::string commitManager;
     crossbow::string storageNodes;
     tell::store::ClientConfig config;
-    int16_t numWarehouses = 0;
+    unsigned numServerThreads = std::thread::hardware_concurrency();
+    size_t maxRunning = 0;
+    size_t maxQueued = 0;
+    unsigned maxAttempts = 1;
+    unsigned retryBackoff = 100;
+    unsigned maxRetryBackoff = 10000;
+    bool warehouseAffinity = false;
+    unsigned maxPerWarehouse = 0;
+    unsigned deliveryWorkers = 0;
+    size_t maxQueuedDeliveries = 0;
+    std::string deliveryLog;
+    bool itemCache = false;
+    tpcc::SchemaLayout layout;
     auto opts = create_options("tpcc_server",
             value<'h'>("help", &help, tag::description{"print help"}),
-            value<'H'>("host", &host, tag::description{"Host to bind to"}),
+            value<'H'>("host", &host, tag::description{"Host to bind to (socket path for unix and shm)"}),
             value<'p'>("port", &port, tag::description{"Port to bind to"}),
+            value<'T'>("transport", &transport, tag::description{"Transport to the clients: tcp, unix or shm"}),
             value<'l'>("log-level", &logLevel, tag::description{"The log level"}),
             value<'c'>("commit-manager", &commitManager, tag::description{"Address to the commit manager"}),
             value<'s'>("storage-nodes", &storageNodes, tag::description{"Semicolon-separated list of storage node addresses"}),
-            value<'W'>("num-warehouses", &numWarehouses, tag::description{"Number of warehouses"}),
-            value<-1>("network-threads", &config.numNetworkThreads, tag::ignore_short<true>{})
+            value<-1>("network-threads", &config.numNetworkThreads, tag::ignore_short<true>{}),
+            value<'t'>("server-threads", &numServerThreads, tag::description{"Number of threads serving client connections"}),
+            value<'m'>("max-running", &maxRunning,
+                tag::description{"Maximum number of concurrently running transactions (0 = unlimited)"}),
+            value<'q'>("max-queued", &maxQueued,
+                tag::description{"Maximum number of transactions waiting to run, more get rejected as busy (0 = unlimited)"}),
+            value<'r'>("max-attempts", &maxAttempts,
+                tag::description{"How often a transaction aborted by a conflict or timeout gets executed (1 = no retries)"}),
+            value<-1>("retry-backoff", &retryBackoff,
+                tag::description{"Backoff before the first retry in microseconds, doubles with every retry"}),
+            value<-1>("max-retry-backoff", &maxRetryBackoff,
+                tag::description{"Upper bound of the backoff between retries in microseconds"}),
+            value<'A'>("warehouse-affinity", &warehouseAffinity,
+                tag::description{"Start and finish the transactions of a warehouse on one server thread (see --max-per-warehouse)"}),
+            value<-1>("max-per-warehouse", &maxPerWarehouse,
+                tag::description{"Maximum number of concurrent read-write transactions per warehouse, "
+                    "implies --warehouse-affinity (0 = unlimited)"}),
+            value<'D'>("delivery-workers", &deliveryWorkers,
+                tag::description{"Number of workers executing deferred deliveries, "
+                    "0 runs them while the client waits"}),
+            value<-1>("max-queued-deliveries", &maxQueuedDeliveries,
+                tag::description{"Maximum number of deferred deliveries waiting, more get rejected as busy "
+                    "(0 = unlimited)"}),
+            value<-1>("delivery-log", &deliveryLog,
+                tag::description{"Path to the completion log of deferred deliveries"}),
+            value<'I'>("item-cache", &itemCache,
+                tag::description{"Keep a copy of the item table in memory, loaded at startup and after population"}),
+            value<-1>("order-line-index", &layout.orderLineIndex,
+                tag::description{"Index the order lines for StockLevel, NewOrder pays for it on every insert (needs to be set for population as well)"}),
+            value<-1>("split-stock", &layout.splitStock,
+                tag::description{"Store the stock counters and the stock texts in two tables (needs to be set for population as well)"}),
+            value<-1>("split-customer", &layout.splitCustomer,
+                tag::description{"Store the customer address and c_data apart from the balances (needs to be set for population as well)"})
             );
     try {
         parse(opts, argc, argv);
@@ -79,10 +118,6 @@ int main(int argc, const char** argv) {
         print_help(std::cout, opts);
         return 0;
     }
-    if (numWarehouses == 0) {
-        std::cerr << "Number of warehouses needs to be set" << std::endl;
-        return 1;
-    }
 
     crossbow::allocator::init();
 
@@ -90,41 +125,39 @@ int main(int argc, const char** argv) {
     config.commitManager = config.parseCommitManager(commitManager);
     config.tellStore = config.parseTellStore(storageNodes);
     tell::db::ClientManager<void> clientManager(config);
+    tpcc::TableCatalog catalog(layout);
     try {
-        io_service service;
-        boost::asio::io_service::work work(service);
-        ip::tcp::acceptor a(service);
-        boost::asio::ip::tcp::acceptor::reuse_address option(true);
-        ip::tcp::resolver resolver(service);
-        ip::tcp::resolver::iterator iter;
-        if (host == "") {
-            iter = resolver.resolve(ip::tcp::resolver::query(port));
-        } else {
-            iter = resolver.resolve(ip::tcp::resolver::query(host, port));
+        tpcc::ServicePool pool(numServerThreads);
+        tpcc::AdmissionControl admission(maxRunning, maxQueued);
+        tpcc::Statistics statistics;
+        tpcc::RetryPolicy retryPolicy(maxAttempts, std::chrono::microseconds(retryBackoff),
+                std::chrono::microseconds(maxRetryBackoff));
+        std::unique_ptr<tpcc::WarehouseAffinity> affinity;
+        if (warehouseAffinity || maxPerWarehouse != 0) {
+            affinity.reset(new tpcc::WarehouseAffinity(pool, maxPerWarehouse));
         }
-        ip::tcp::resolver::iterator end;
-        for (; iter != end; ++iter) {
-            boost::system::error_code err;
-            auto endpoint = iter->endpoint();
-            auto protocol = iter->endpoint().protocol();
-            a.open(protocol);
-            a.set_option(option);
-            a.bind(endpoint, err);
-            if (err) {
-                a.close();
-                LOG_WARN("Bind attempt failed " + err.message());
-                continue;
-            }
-            break;
+        std::unique_ptr<tpcc::DeliveryQueue> deliveries;
+        if (deliveryWorkers != 0) {
+            deliveries.reset(new tpcc::DeliveryQueue(pool, clientManager, catalog, statistics, retryPolicy,
+                        deliveryWorkers, maxQueuedDeliveries, deliveryLog));
         }
-        if (!a.is_open()) {
-            LOG_ERROR("Could not bind");
-            return 1;
+        std::unique_ptr<tpcc::ItemCache> items;
+        if (itemCache) {
+            items.reset(new tpcc::ItemCache(clientManager, catalog, numServerThreads));
+            if (!items->load()) {
+                LOG_INFO("Item table not populated yet, the item cache gets loaded after population");
+            }
         }
-        a.listen();
-        // we do not need to delete this object, it will delete itself
-        accept(service, a, clientManager, numWarehouses);
-        service.run();
+        tpcc::Listener listener(pool, tpcc::transportFromString(transport), host, port);
+        listener.accept([&pool, &admission, &statistics, &retryPolicy, &affinity, &deliveries,
+                    &items, &clientManager, &catalog](
+                    std::unique_ptr<tpcc::Stream> stream) {
+            // we do not need to delete this object, it will delete itself
+            auto conn = new tpcc::Connection(std::move(stream), pool, admission, statistics, retryPolicy,
+                    affinity.get(), deliveries.get(), items.get(), clientManager, catalog);
+            conn->run();
+        });
+        pool.run();
     } catch (std::exception& e) {
         std::cerr << e.what() << std::endl;
     }
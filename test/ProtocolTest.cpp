@@ -0,0 +1,300 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include <common/Protocol.hpp>
+#include <common/Transport.hpp>
+
+#include <boost/asio.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace tpcc;
+using err_code = boost::system::error_code;
+
+namespace {
+
+unsigned failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed" << std::endl; \
+            ++failures; \
+        } \
+    } while (false)
+
+/**
+ * Answers every request with a default constructed result and counts the
+ * new-order transactions it got to see.
+ */
+struct FakeImpl {
+    unsigned requests = 0;
+    unsigned newOrders = 0;
+    bool closed = false;
+
+    template<Command C, class Callback>
+    typename std::enable_if<std::is_void<typename Signature<C>::result>::value, void>::type
+    execute(const Callback& callback) {
+        ++requests;
+        callback();
+    }
+
+    template<Command C, class Callback>
+    typename std::enable_if<!std::is_void<typename Signature<C>::result>::value, void>::type
+    execute(const Callback& callback) {
+        ++requests;
+        callback(typename Signature<C>::result());
+    }
+
+    template<Command C, class Args, class Callback>
+    typename std::enable_if<std::is_void<typename Signature<C>::result>::value, void>::type
+    execute(const Args&, const Callback& callback) {
+        ++requests;
+        callback();
+    }
+
+    template<Command C, class Args, class Callback>
+    typename std::enable_if<!std::is_void<typename Signature<C>::result>::value, void>::type
+    execute(const Args&, const Callback& callback) {
+        ++requests;
+        if (C == Command::NEW_ORDER) {
+            ++newOrders;
+        }
+        callback(typename Signature<C>::result());
+    }
+
+    void close() {
+        closed = true;
+    }
+};
+
+/**
+ * A frame header as the peer would write it, followed by size - header
+ * zero bytes - a huge size is only announced, not sent.
+ */
+std::vector<uint8_t> frame(size_t size, uint64_t id, size_t headerSize) {
+    std::vector<uint8_t> res(size > impl::MAX_FRAME_SIZE ? headerSize : std::max(size, headerSize), 0);
+    memcpy(res.data(), &size, sizeof(size));
+    memcpy(res.data() + sizeof(size), &id, sizeof(id));
+    return res;
+}
+
+std::vector<uint8_t> requestFrame(size_t size, Command cmd) {
+    auto res = frame(size, 1, impl::REQUEST_HEADER_SIZE);
+    auto version = impl::WIRE_VERSION;
+    memcpy(res.data() + impl::RESPONSE_HEADER_SIZE, &cmd, sizeof(cmd));
+    memcpy(res.data() + impl::RESPONSE_HEADER_SIZE + sizeof(cmd), &version, sizeof(version));
+    return res;
+}
+
+/**
+ * A frame of the given header size whose payload is exactly payload, padded
+ * like endFrame does it.
+ */
+std::vector<uint8_t> withPayload(std::vector<uint8_t> frame, const Buffer& payload) {
+    auto headerSize = frame.size();
+    auto size = headerSize + payload.size();
+    size += (impl::FRAME_ALIGNMENT - size % impl::FRAME_ALIGNMENT) % impl::FRAME_ALIGNMENT;
+    frame.resize(size, 0);
+    memcpy(frame.data(), &size, sizeof(size));
+    std::copy(payload.data(), payload.data() + payload.size(), frame.begin() + headerSize);
+    return frame;
+}
+
+/**
+ * The server has to close the connection after reading bytes, without
+ * dispatching anything to the implementation.
+ */
+void expectServerCloses(const std::vector<uint8_t>& bytes) {
+    boost::asio::io_service service;
+    UnixStream clientStream(service);
+    UnixStream serverStream(service);
+    boost::asio::local::connect_pair(clientStream.socket(), serverStream.socket());
+    FakeImpl impl;
+    server::Server<FakeImpl> server(impl, serverStream);
+    server.run();
+    boost::asio::write(clientStream.socket(), boost::asio::buffer(bytes));
+    service.run();
+    CHECK(impl.closed);
+    CHECK(impl.requests == 0);
+}
+
+/**
+ * A client which receives bytes as response has to fail its pending request
+ * instead of looping or dispatching it to the wrong callback.
+ */
+void expectClientFails(const std::vector<uint8_t>& bytes) {
+    boost::asio::io_service service;
+    UnixStream clientStream(service);
+    UnixStream serverStream(service);
+    boost::asio::local::connect_pair(clientStream.socket(), serverStream.socket());
+    boost::asio::write(serverStream.socket(), boost::asio::buffer(bytes));
+    client::CommandsImpl commands(clientStream);
+    bool called = false;
+    commands.execute<Command::STATS>([&called](const err_code& ec, const StatsResult&) {
+        CHECK(ec);
+        called = true;
+    });
+    service.run();
+    CHECK(called);
+    CHECK(commands.numPending() == 0);
+}
+
+void testInvalidFrames() {
+    // sizes which do not even cover the header, are not aligned or are huge
+    expectServerCloses(requestFrame(0, Command::STATS));
+    expectServerCloses(requestFrame(impl::REQUEST_HEADER_SIZE - impl::FRAME_ALIGNMENT, Command::STATS));
+    expectServerCloses(requestFrame(impl::REQUEST_HEADER_SIZE + 1, Command::STATS));
+    expectServerCloses(requestFrame(size_t(1) << 40, Command::STATS));
+    // a new-order whose arguments would be read past the end of the frame
+    expectServerCloses(requestFrame(impl::REQUEST_HEADER_SIZE, Command::NEW_ORDER));
+    // a command which does not exist
+    expectServerCloses(requestFrame(impl::REQUEST_HEADER_SIZE, Command(200)));
+
+    expectClientFails(frame(0, 1, impl::RESPONSE_HEADER_SIZE));
+    expectClientFails(frame(impl::RESPONSE_HEADER_SIZE + 1, 1, impl::RESPONSE_HEADER_SIZE));
+    expectClientFails(frame(size_t(1) << 40, 1, impl::RESPONSE_HEADER_SIZE));
+    // the id of a request which was never sent
+    expectClientFails(frame(impl::RESPONSE_HEADER_SIZE, 42, impl::RESPONSE_HEADER_SIZE));
+}
+
+/**
+ * Lengths of serialized vectors and strings come from the peer - ones which
+ * do not fit into the rest of the frame must neither be allocated nor read.
+ */
+void testInvalidLengths() {
+    const uint32_t huge = std::numeric_limits<uint32_t>::max();
+    {
+        // a batch of more transactions than the frame holds
+        Buffer payload;
+        BufferWriter writer(payload);
+        writer & huge;
+        expectServerCloses(withPayload(requestFrame(impl::REQUEST_HEADER_SIZE, Command::BATCH), payload));
+    }
+    {
+        // a payment whose customer name is longer than the frame
+        Buffer payload;
+        BufferWriter writer(payload);
+        writer & false & int16_t(1) & int16_t(1) & int32_t(1) & int16_t(1) & int16_t(1) & uint32_t(100);
+        expectServerCloses(withPayload(requestFrame(impl::REQUEST_HEADER_SIZE, Command::PAYMENT), payload));
+    }
+    {
+        // statistics of more commands than the frame holds
+        Buffer payload;
+        BufferWriter writer(payload);
+        writer & uint64_t(0) & uint64_t(0) & huge;
+        expectClientFails(withPayload(frame(impl::RESPONSE_HEADER_SIZE, 1, impl::RESPONSE_HEADER_SIZE), payload));
+    }
+}
+
+NewOrderIn newOrder(int16_t o_ol_cnt) {
+    NewOrderIn in;
+    memset(&in, 0, sizeof(in));
+    in.w_id = 1;
+    in.d_id = 1;
+    in.c_id = 1;
+    in.o_ol_cnt = o_ol_cnt;
+    for (size_t i = 0; i < MAX_ORDER_LINES; ++i) {
+        in.lines[i].ol_i_id = int32_t(i + 1);
+        in.lines[i].ol_supply_w_id = 1;
+        in.lines[i].ol_quantity = 5;
+    }
+    return in;
+}
+
+/**
+ * Sends a new-order with an order line count outside of 1 to MAX_ORDER_LINES
+ * on its own and in a batch: the server has to answer with an INVALID error
+ * without passing it to the implementation.
+ */
+void testOrderLineCount() {
+    boost::asio::io_service service;
+    UnixStream clientStream(service);
+    UnixStream serverStream(service);
+    boost::asio::local::connect_pair(clientStream.socket(), serverStream.socket());
+    FakeImpl impl;
+    server::Server<FakeImpl> server(impl, serverStream);
+    server.run();
+    client::CommandsImpl commands(clientStream);
+
+    std::vector<NewOrderResult> results;
+    const std::vector<int16_t> counts = {0, -1, int16_t(MAX_ORDER_LINES + 1), std::numeric_limits<int16_t>::max(), 5};
+    size_t outstanding = counts.size() + 1;
+    auto done = [&outstanding, &service]() {
+        if (--outstanding == 0) {
+            service.stop();
+        }
+    };
+    for (auto count : counts) {
+        commands.execute<Command::NEW_ORDER>([&results, done](const err_code& ec, const NewOrderResult& res) {
+            CHECK(!ec);
+            results.push_back(res);
+            done();
+        }, newOrder(count));
+    }
+    std::vector<TransactionIn> batch(2);
+    batch[0].command = Command::NEW_ORDER;
+    batch[0].newOrder = newOrder(int16_t(MAX_ORDER_LINES + 1));
+    batch[1].command = Command::NEW_ORDER;
+    batch[1].newOrder = newOrder(int16_t(MAX_ORDER_LINES));
+    commands.execute<Command::BATCH>([&results, done](const err_code& ec, const std::vector<TransactionResult>& res) {
+        CHECK(!ec);
+        CHECK(res.size() == 2);
+        for (const auto& r : res) {
+            results.push_back(r.newOrder);
+        }
+        done();
+    }, batch);
+    service.run();
+
+    CHECK(results.size() == 7);
+    if (results.size() != 7) {
+        return;
+    }
+    unsigned invalid = 0;
+    for (const auto& res : results) {
+        if (!res.success) {
+            CHECK(res.abortReason == AbortReason::INVALID);
+            CHECK(!res.error.empty());
+            ++invalid;
+        }
+    }
+    CHECK(invalid == 5);
+    CHECK(impl.newOrders == 2);
+}
+
+} // anonymous namespace
+
+int main() {
+    testInvalidFrames();
+    testInvalidLengths();
+    testOrderLineCount();
+    if (failures != 0) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}